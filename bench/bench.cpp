@@ -0,0 +1,360 @@
+/**
+ * Microbenchmarks of the per-frame hot path on synthetic data: zone analysis, color math, layer
+ * blending and HID packet encoding. Prints one JSON object per benchmark and line, e.g.
+ *   {"name":"analyze_full","params":"3840x2160 zones=10,10,10,10","iterations":4096,"ns_per_op":812.5,"bytes_per_s":1.2e+10}
+ */
+#include "animations.hpp"
+#include "color_encoder.hpp"
+#include "compositor.hpp"
+#include "hid_device.hpp"
+#include "metrics.hpp"
+#include "worker_pool.hpp"
+#include "zone.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace led;
+
+namespace
+{
+
+struct bench_options
+{
+    std::string filter;
+    double min_seconds = 0.2;
+    /** largest WorkerPool measured by analyze_pool, defaults to the core count */
+    size_t max_workers = std::max(1u, std::thread::hardware_concurrency());
+};
+
+/** Consumed results go here so the optimizer cannot drop the measured work. */
+volatile uint64_t g_sink = 0;
+
+/**
+ * Times `op()` in five batches sized to fill `min_seconds` together, prints the median batch and
+ * returns its seconds per call, 0 when the filter skips it. `bytes_per_op` is the amount of input
+ * one call processes.
+ */
+template <typename Op>
+double run(const bench_options& options, const std::string& name, const std::string& params, double bytes_per_op, Op op)
+{
+    if (!options.filter.empty() && (name + ' ' + params).find(options.filter) == std::string::npos) return 0.0;
+
+    using clock = std::chrono::steady_clock;
+    auto time_batch = [&](uint64_t n) {
+        auto start = clock::now();
+        for (uint64_t i = 0; i < n; ++i)
+            op();
+        return std::chrono::duration<double>(clock::now() - start).count();
+    };
+
+    op();
+    uint64_t n = 1;
+    while (time_batch(n) < options.min_seconds / 5 && n < (uint64_t(1) << 40))
+        n *= 2;
+
+    std::vector<double> batches;
+    for (int b = 0; b < 5; ++b)
+        batches.push_back(time_batch(n) / n);
+    std::sort(batches.begin(), batches.end());
+    double seconds = batches[batches.size() / 2];
+
+    std::printf("{\"name\":\"%s\",\"params\":\"%s\",\"iterations\":%llu,\"ns_per_op\":%.3f,\"bytes_per_s\":%.4g}\n", name.c_str(), params.c_str(), static_cast<unsigned long long>(n * 5),
+                seconds * 1e9, bytes_per_op / seconds);
+    std::fflush(stdout);
+    return seconds;
+}
+
+struct resolution
+{
+    int width, height;
+};
+
+struct zone_config
+{
+    int bottom, left, top, right;
+};
+
+std::string zone_param(const zone_config& z)
+{
+    return "zones=" + std::to_string(z.bottom) + ',' + std::to_string(z.left) + ',' + std::to_string(z.top) + ',' + std::to_string(z.right);
+}
+
+/** Bytes ZoneAnalyzer actually reads for the layout of its last call. */
+double sampled_bytes(const ZoneAnalyzer& analyzer, int bpp)
+{
+    double pixels = 0;
+    for (const auto& r : analyzer.zone_rects())
+        pixels += static_cast<double>(r.width) * r.height;
+    return pixels * bpp / (static_cast<double>(analyzer.sample_stride()) * analyzer.sample_stride());
+}
+
+/** One 8K BGRA buffer of noise, reused for every resolution. */
+std::vector<uint8_t> noise_frame()
+{
+    std::vector<uint8_t> frame(static_cast<size_t>(7680) * 4320 * 4);
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    for (size_t i = 0; i + 8 <= frame.size(); i += 8) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        std::memcpy(&frame[i], &state, 8);
+    }
+    return frame;
+}
+
+void bench_analysis(const bench_options& options, std::vector<uint8_t>& frame)
+{
+    const resolution resolutions[] = { { 1920, 1080 }, { 2560, 1440 }, { 3840, 2160 }, { 7680, 4320 } };
+    const zone_config configs[] = { { 4, 4, 4, 4 }, { 10, 10, 10, 10 }, { 16, 9, 16, 9 } };
+    const int depth = 10;
+
+    for (const auto& res : resolutions) {
+        std::string size = std::to_string(res.width) + 'x' + std::to_string(res.height);
+        int row = res.width * 4;
+
+        /** the border strips are views into the full frame, as with a zero-copy capture */
+        BorderStrips strips;
+        strips.width = res.width;
+        strips.height = res.height;
+        strips.depth = depth;
+        strips.top = { frame.data(), row };
+        strips.bottom = { frame.data() + static_cast<size_t>(res.height - depth) * row, row };
+        strips.left = { frame.data() + static_cast<size_t>(depth) * row, row };
+        strips.right = { frame.data() + static_cast<size_t>(depth) * row + (res.width - depth) * 4, row };
+
+        for (const auto& z : configs) {
+            std::vector<ZoneColor> zones(ZoneAnalyzer::zone_count(z.bottom, z.left, z.top, z.right));
+            std::string params = size + ' ' + zone_param(z);
+
+            ZoneAnalyzer full(depth);
+            full.analyze(frame.data(), res.width, res.height, 4, z.bottom, z.left, z.top, z.right, std::span<ZoneColor>(zones));
+            run(options, "analyze_full", params, sampled_bytes(full, 4), [&] {
+                full.analyze(frame.data(), res.width, res.height, 4, z.bottom, z.left, z.top, z.right, std::span<ZoneColor>(zones));
+                g_sink = g_sink + zones[0].r;
+            });
+
+            ZoneAnalyzer border(depth);
+            border.analyze(strips, z.bottom, z.left, z.top, z.right, std::span<ZoneColor>(zones));
+            run(options, "analyze_border", params, sampled_bytes(border, 4), [&] {
+                border.analyze(strips, z.bottom, z.left, z.top, z.right, std::span<ZoneColor>(zones));
+                g_sink = g_sink + zones[0].r;
+            });
+        }
+    }
+}
+
+/**
+ * Full-frame analysis of every pixel format at 1080p, with rows padded by 64 bytes as XImage
+ * scanlines can be, so the stride is not width * bpp.
+ */
+void bench_formats(const bench_options& options, std::vector<uint8_t>& frame)
+{
+    const resolution res{ 1920, 1080 };
+    const zone_config z{ 10, 10, 10, 10 };
+    const PixelFormat formats[] = { PixelFormat::bgra32, PixelFormat::bgrx32, PixelFormat::bgr24, PixelFormat::rgb565, PixelFormat::rgba32, PixelFormat::rgb24 };
+    const char* names[] = { "bgra32", "bgrx32", "bgr24", "rgb565", "rgba32", "rgb24" };
+    std::vector<ZoneColor> zones(ZoneAnalyzer::zone_count(z.bottom, z.left, z.top, z.right));
+
+    for (size_t f = 0; f < std::size(formats); ++f) {
+        int bpp = bytes_per_pixel(formats[f]);
+        ImageView image{ frame.data(), res.width, res.height, res.width * bpp + 64, formats[f] };
+
+        ZoneAnalyzer analyzer(10);
+        analyzer.analyze(image, z.bottom, z.left, z.top, z.right, std::span<ZoneColor>(zones));
+        run(options, "analyze_format", std::string(names[f]) + " 1920x1080 " + zone_param(z), sampled_bytes(analyzer, bpp), [&] {
+            analyzer.analyze(image, z.bottom, z.left, z.top, z.right, std::span<ZoneColor>(zones));
+            g_sink = g_sink + zones[0].r;
+        });
+    }
+}
+
+/**
+ * Scaling of the pooled analysis from 1 to `max_workers` threads at 4K and 8K, for the default
+ * border depth and for deep zones where the pixel work dominates the dispatch. Besides the JSON
+ * lines, each series is summarized as a speedup table on stderr; pools larger than the core
+ * count it names are oversubscribed and cannot speed up.
+ */
+void bench_pool(const bench_options& options, std::vector<uint8_t>& frame)
+{
+    const resolution resolutions[] = { { 3840, 2160 }, { 7680, 4320 } };
+    const zone_config z{ 10, 10, 10, 10 };
+    std::vector<ZoneColor> zones(ZoneAnalyzer::zone_count(z.bottom, z.left, z.top, z.right));
+    uint8_t* pixels = frame.data();
+
+    for (const auto& res : resolutions) {
+        for (int depth : { 10, 100 }) {
+            std::vector<double> seconds;
+            for (size_t workers = 1; workers <= options.max_workers; ++workers) {
+                WorkerPool pool(workers);
+                ZoneAnalyzer analyzer(depth);
+                analyzer.set_worker_pool(&pool);
+                analyzer.analyze(pixels, res.width, res.height, 4, z.bottom, z.left, z.top, z.right, std::span<ZoneColor>(zones));
+
+                std::string params = std::to_string(res.width) + 'x' + std::to_string(res.height) + ' ' + zone_param(z) + " depth=" + std::to_string(depth) +
+                                     " workers=" + std::to_string(workers);
+                seconds.push_back(run(options, "analyze_pool", params, sampled_bytes(analyzer, 4), [&] {
+                    analyzer.analyze(pixels, res.width, res.height, 4, z.bottom, z.left, z.top, z.right, std::span<ZoneColor>(zones));
+                    g_sink = g_sink + zones[0].r;
+                }));
+            }
+
+            if (seconds.front() <= 0.0) continue;
+            std::fprintf(stderr, "analyze_pool %dx%d depth=%d on %u cores\n%8s %10s %8s %11s\n", res.width, res.height, depth, std::thread::hardware_concurrency(), "workers",
+                         "ms/frame", "speedup", "efficiency");
+            for (size_t w = 0; w < seconds.size(); ++w) {
+                if (seconds[w] <= 0.0) continue;
+                double speedup = seconds.front() / seconds[w];
+                std::fprintf(stderr, "%8zu %10.3f %8.2f %10.0f%%\n", w + 1, seconds[w] * 1e3, speedup, speedup / static_cast<double>(w + 1) * 100.0);
+            }
+        }
+    }
+}
+
+void bench_color(const bench_options& options)
+{
+    const size_t count = 1024;
+    std::vector<color> colors(count);
+    for (size_t i = 0; i < count; ++i)
+        colors[i] = { static_cast<uint8_t>(i), static_cast<uint8_t>(i * 3), static_cast<uint8_t>(i * 7) };
+
+    size_t i = 0;
+    run(options, "color_scaled", "double", 3, [&] {
+        color c = colors[i % count].scaled((i % 256) / 255.0);
+        g_sink = g_sink + c.r + c.g + c.b;
+        ++i;
+    });
+    run(options, "color_scaled_fine", "level", 3, [&] {
+        color16 c = colors[i % count].scaled_fine(static_cast<uint32_t>(i % 65537));
+        g_sink = g_sink + c.r + c.g + c.b;
+        ++i;
+    });
+    run(options, "hsv_to_rgb", "s=1 v=1", 3, [&] {
+        color16 c = rainbow_animation::hsv_to_rgb(static_cast<double>(i % 3600) / 10.0, 1.0, 1.0);
+        g_sink = g_sink + c.r + c.g + c.b;
+        ++i;
+    });
+
+    for (size_t zones : { size_t(40), size_t(54) }) {
+        std::vector<color16> in(zones);
+        for (size_t z = 0; z < zones; ++z)
+            in[z] = colors[z].scaled_fine(40000);
+        std::vector<color> out;
+
+        for (bool dither : { false, true }) {
+            color_encoder encoder(2.2, dither);
+            std::string params = "leds=" + std::to_string(zones) + (dither ? " gamma=2.2 dither" : " gamma=2.2");
+            run(options, "color_encode", params, zones * sizeof(color16), [&] {
+                encoder.encode(std::span<const color16>(in), out);
+                g_sink = g_sink + out[0].r;
+            });
+        }
+    }
+}
+
+void bench_packets(const bench_options& options)
+{
+    for (size_t zones : { size_t(20), size_t(40), size_t(54), size_t(120), size_t(255) }) {
+        std::vector<color> colors(zones);
+        for (size_t z = 0; z < zones; ++z)
+            colors[z] = { static_cast<uint8_t>(z), static_cast<uint8_t>(z * 5), static_cast<uint8_t>(z * 11) };
+        report_encoder encoder;
+        std::string params = "leds=" + std::to_string(zones);
+
+        run(options, "hid_encode_reports", params, zones * 3, [&] {
+            encoder.encode(colors);
+            g_sink = g_sink + encoder.report(0)[4];
+        });
+    }
+}
+
+/** One blend pass per mode and instruction set, and whole frames of a growing layer stack. */
+void bench_compose(const bench_options& options)
+{
+    const size_t zones = 255;
+    std::vector<color16> dst(zones), src(zones);
+    for (size_t i = 0; i < zones; ++i) {
+        dst[i] = { static_cast<uint16_t>(i * 251), static_cast<uint16_t>(i * 97), static_cast<uint16_t>(0xFF00 - i * 13) };
+        src[i] = { static_cast<uint16_t>(i * 61), static_cast<uint16_t>(0xFF00 - i * 29), static_cast<uint16_t>(i * 173) };
+    }
+    uint16_t* d = reinterpret_cast<uint16_t*>(dst.data());
+    const uint16_t* s = reinterpret_cast<const uint16_t*>(src.data());
+
+    const std::pair<blend_mode, const char*> modes[] = { { blend_mode::alpha, "alpha" }, { blend_mode::add, "add" }, { blend_mode::multiply, "multiply" }, { blend_mode::max, "max" } };
+    const std::pair<blend_kernel (*)(blend_mode), const char*> isas[] = { { blend_kernel_scalar, "scalar" }, { blend_kernel_sse2, "sse2" }, { blend_kernel_avx2, "avx2" } };
+    for (const auto& [mode, mode_name] : modes) {
+        for (const auto& [kernel_for, isa] : isas) {
+            if (std::strcmp(isa, "avx2") == 0 && select_blend_kernel(mode) != blend_kernel_avx2(mode)) continue;
+            blend_kernel kernel = kernel_for(mode);
+            std::string params = std::string(mode_name) + " leds=" + std::to_string(zones) + " kernel=" + isa;
+            /** half opacity takes the full path: blend, then mix with what was below */
+            run(options, "blend_layer", params, zones * sizeof(color16), [&] {
+                kernel(d, s, zones * 3, k_opaque / 2);
+                g_sink = g_sink + d[0];
+            });
+        }
+    }
+
+    /** a rainbow base under breathing, wave and solid layers, everything from precomputed tables */
+    for (size_t layers = 1; layers <= 4; ++layers) {
+        compositor stack;
+        stack.add_layer(rainbow_animation::layer(zones));
+        if (layers > 1) stack.add_layer(breathing_animation::layer(color{ 255, 255, 255 }, zones), blend_mode::multiply);
+        if (layers > 2) stack.add_layer(wave_animation::layer(color{ 0, 0, 255 }, zones), blend_mode::add, k_opaque / 2);
+        if (layers > 3) stack.add_layer(solid_animation::layer(color{ 40, 40, 40 }), blend_mode::max);
+
+        auto now = renderer::clock::now();
+        run(options, "compose_frame", "layers=" + std::to_string(layers) + " leds=" + std::to_string(zones), zones * sizeof(color16), [&] {
+            now += std::chrono::milliseconds(16);
+            stack.compose(now, dst);
+            g_sink = g_sink + dst[0].r;
+        });
+    }
+}
+
+/** Cost of one scoped_timer, i.e. what every instrumented stage pays per frame. */
+void bench_metrics(const bench_options& options)
+{
+    latency_histogram histogram;
+    run(options, "metrics_timer", "scoped_timer", 0, [&] { scoped_timer timer(histogram); });
+    g_sink = g_sink + histogram.count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    bench_options options;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            options.min_seconds = std::max(0.001, std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--max-workers") == 0 && i + 1 < argc) {
+            options.max_workers = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        } else {
+            std::cerr << "Usage: nlctl_bench [--filter substring] [--min-time seconds] [--max-workers n]\n";
+            return 1;
+        }
+    }
+
+    bench_color(options);
+    bench_packets(options);
+    bench_compose(options);
+    bench_metrics(options);
+
+    std::vector<uint8_t> frame = noise_frame();
+    bench_analysis(options, frame);
+    bench_formats(options, frame);
+    bench_pool(options, frame);
+    return 0;
+}
@@ -1,6 +1,9 @@
 #pragma once
 #include "color.hpp"
+#include "color_encoder.hpp"
+#include "frame_scheduler.hpp"
 #include "hid_device.hpp"
+#include <atomic>
 #include <chrono>
 
 namespace led
@@ -12,11 +15,52 @@ class animation_base
     hid_device_wrapper& device_;
     color base_color_;
     std::chrono::milliseconds duration_;
+    /** paces the frames of run(), animations set their own period */
+    frame_scheduler scheduler_;
+    /** gamma and dithering applied to every frame before it is sent */
+    color_encoder encoder_;
+    /** set by stop(), checked by run() once per frame */
+    std::atomic<bool> stop_{ false };
 
   public:
     animation_base(hid_device_wrapper& dev, const color& c, std::chrono::milliseconds dur);
     virtual ~animation_base() = default;
     virtual void run() = 0;
+
+    /** Makes run() return after the frame in progress; may be called from any thread. */
+    void stop()
+    {
+        stop_.store(true, std::memory_order_relaxed);
+        stop_.notify_all();
+    }
+
+    bool stopped() const
+    {
+        return stop_.load(std::memory_order_relaxed);
+    }
+
+    /** Clears stop() before run() is called again, starting a new frame grid so the pause is not counted as missed frames. */
+    virtual void resume()
+    {
+        stop_.store(false, std::memory_order_relaxed);
+        scheduler_.restart();
+    }
+
+    color_encoder& encoder()
+    {
+        return encoder_;
+    }
+
+    /** Whether late frames are skipped (the default) or played back to back; not while run() is active. */
+    void set_overrun_policy(overrun_policy policy)
+    {
+        scheduler_.set_policy(policy);
+    }
+
+    const frame_stats& frame_timing() const
+    {
+        return scheduler_.stats();
+    }
 };
 
 } // namespace led
\ No newline at end of file
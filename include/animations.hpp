@@ -1,10 +1,22 @@
 #pragma once
 #include "animation_base.hpp"
 #include "capture.hpp"
+#include "capture_governor.hpp"
+#include "compositor.hpp"
+#include "frame_interpolator.hpp"
+#include "metrics.hpp"
+#include "pipeline.hpp"
+#include "worker_pool.hpp"
 #include "zone.hpp"
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <iostream>
+#include <memory>
 #include <numbers>
+#include <span>
+#include <stdexcept>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -18,30 +30,152 @@ class solid_animation : public animation_base
 
     void run() override
     {
-        std::vector<color> colors(device_.zone_count(), base_color_);
+        std::vector<color16> frame(device_.zone_count(), base_color_.widened());
+        std::vector<color> colors;
+        encoder_.encode(std::span<const color16>(frame), colors);
         device_.set_colors(colors);
     }
+
+    /** The same color as a compositor layer. */
+    static std::unique_ptr<renderer> layer(const color& base);
+};
+
+/**
+ * One full cycle of a periodic animation, rendered up front in 8.8 fixed point so that playing a
+ * frame back is a table row through the color_encoder instead of per-LED trigonometry.
+ */
+class frame_table
+{
+    size_t frames_ = 0;
+    size_t zones_ = 0;
+    std::vector<color16> colors_;
+
+  public:
+    frame_table() = default;
+    frame_table(size_t frames, size_t zones) : frames_(frames), zones_(zones), colors_(frames * zones)
+    {
+    }
+
+    size_t frames() const
+    {
+        return frames_;
+    }
+
+    size_t zones() const
+    {
+        return zones_;
+    }
+
+    color16* frame(size_t index)
+    {
+        return colors_.data() + index * zones_;
+    }
+
+    std::span<const color16> row(size_t index) const
+    {
+        return { colors_.data() + index * zones_, zones_ };
+    }
+};
+
+/**
+ * Renders every frame of a cycle with `render(frame, zones, out)` into a table.
+ */
+template <typename Render>
+frame_table render_cycle(size_t frames, size_t zones, Render&& render)
+{
+    frame_table table(frames, zones);
+    for (size_t frame = 0; frame < frames; ++frame)
+        render(frame, zones, table.frame(frame));
+    return table;
+}
+
+/** Shows `base` on every LED. */
+class solid_renderer : public renderer
+{
+    color16 base_;
+
+  public:
+    explicit solid_renderer(const color& base) : base_(base.widened())
+    {
+    }
+
+    void render(clock::time_point, std::span<color16> out) override
+    {
+        std::fill(out.begin(), out.end(), base_);
+    }
+};
+
+inline std::unique_ptr<renderer> solid_animation::layer(const color& base)
+{
+    return std::make_unique<solid_renderer>(base);
+}
+
+/**
+ * Plays a frame_table back by time instead of by frame count: one cycle per `period`, starting
+ * with the first render, so the cycle keeps its speed at whatever rate the compositor runs.
+ * LEDs beyond the table stay black.
+ */
+class cycle_renderer : public renderer
+{
+    frame_table table_;
+    std::chrono::nanoseconds period_;
+    clock::time_point start_{};
+    bool started_ = false;
+
+  public:
+    cycle_renderer(frame_table table, std::chrono::nanoseconds period) : table_(std::move(table)), period_(std::max(period, std::chrono::nanoseconds(1)))
+    {
+    }
+
+    void render(clock::time_point now, std::span<color16> out) override
+    {
+        if (!started_) {
+            start_ = now;
+            started_ = true;
+        }
+
+        size_t zones = 0;
+        if (table_.frames() > 0) {
+            int64_t phase = std::max<int64_t>(0, (now - start_).count()) % period_.count();
+            auto row = table_.row(static_cast<size_t>(phase * static_cast<int64_t>(table_.frames()) / period_.count()));
+            zones = std::min(row.size(), out.size());
+            std::copy_n(row.begin(), zones, out.begin());
+        }
+        std::fill(out.begin() + zones, out.end(), color16{ 0, 0, 0 });
+    }
 };
 
 class breathing_animation : public animation_base
 {
     size_t steps_;
+    frame_table table_;
+    std::vector<color> colors_;
 
   public:
     breathing_animation(hid_device_wrapper& dev, const color& c, std::chrono::milliseconds dur = std::chrono::milliseconds(3000), size_t steps = 500)
         : animation_base(dev, c, dur), steps_(steps)
     {
+        scheduler_.set_period(std::chrono::duration_cast<std::chrono::nanoseconds>(duration_) / steps_);
+        table_ = render_cycle(steps_, device_.zone_count(), [this](size_t frame, size_t zones, color16* out) { render_frame(base_color_, steps_, frame, zones, out); });
     }
 
-    void run() override
+    static void render_frame(const color& base, size_t steps, size_t frame, size_t zones, color16* out)
     {
-        auto delay = duration_ / steps_;
+        double brightness = (std::sin(frame * 2.0 * std::numbers::pi / steps) + 1.0) / 2.0;
+        std::fill(out, out + zones, base.scaled_fine(brightness_level(brightness)));
+    }
 
-        for (size_t frame = 0; frame < steps_; ++frame) {
-            double brightness = (std::sin(frame * 2.0 * std::numbers::pi / steps_) + 1.0) / 2.0;
-            std::vector<color> colors(device_.zone_count(), base_color_.scaled(brightness));
-            device_.set_colors(colors);
-            std::this_thread::sleep_for(delay);
+    /** The cycle as a compositor layer; in white and blended with `multiply` it is a brightness envelope for the layers below. */
+    static std::unique_ptr<renderer> layer(const color& base, size_t zones, std::chrono::milliseconds dur = std::chrono::milliseconds(3000), size_t steps = 500)
+    {
+        return std::make_unique<cycle_renderer>(render_cycle(steps, zones, [&](size_t frame, size_t z, color16* out) { render_frame(base, steps, frame, z, out); }), dur);
+    }
+
+    void run() override
+    {
+        for (size_t frame = 0; frame < steps_ && !stopped(); frame += scheduler_.wait()) {
+            encoder_.encode(table_.row(frame), colors_);
+            device_.set_colors(colors_);
         }
     }
 };
@@ -49,30 +183,36 @@ class breathing_animation : public animation_base
 class wave_animation : public animation_base
 {
     size_t frames_;
+    frame_table table_;
+    std::vector<color> colors_;
 
   public:
     wave_animation(hid_device_wrapper& dev, const color& c, std::chrono::milliseconds dur = std::chrono::milliseconds(2000), size_t frames = 50)
         : animation_base(dev, c, dur), frames_(frames)
     {
+        scheduler_.set_period(std::chrono::duration_cast<std::chrono::nanoseconds>(duration_) / frames_);
+        table_ = render_cycle(frames_, device_.zone_count(), [this](size_t frame, size_t zones, color16* out) { render_frame(base_color_, frame, zones, out); });
     }
 
-    void run() override
+    static void render_frame(const color& base, size_t frame, size_t zones, color16* out)
     {
-        auto delay = duration_ / frames_;
-        size_t zones = device_.zone_count();
-
-        for (size_t frame = 0; frame < frames_; ++frame) {
-            std::vector<color> colors;
-            colors.reserve(zones);
+        for (size_t i = 0; i < zones; ++i) {
+            double offset = (i + frame) * 2.0 * std::numbers::pi / zones;
+            double brightness = (std::sin(offset) + 1.0) / 2.0;
+            out[i] = base.scaled_fine(brightness_level(brightness));
+        }
+    }
 
-            for (size_t i = 0; i < zones; ++i) {
-                double offset = (i + frame) * 2.0 * std::numbers::pi / zones;
-                double brightness = (std::sin(offset) + 1.0) / 2.0;
-                colors.push_back(base_color_.scaled(brightness));
-            }
+    static std::unique_ptr<renderer> layer(const color& base, size_t zones, std::chrono::milliseconds dur = std::chrono::milliseconds(2000), size_t frames = 50)
+    {
+        return std::make_unique<cycle_renderer>(render_cycle(frames, zones, [&](size_t frame, size_t z, color16* out) { render_frame(base, frame, z, out); }), dur);
+    }
 
-            device_.set_colors(colors);
-            std::this_thread::sleep_for(delay);
+    void run() override
+    {
+        for (size_t frame = 0; frame < frames_ && !stopped(); frame += scheduler_.wait()) {
+            encoder_.encode(table_.row(frame), colors_);
+            device_.set_colors(colors_);
         }
     }
 };
@@ -80,8 +220,11 @@ class wave_animation : public animation_base
 class rainbow_animation : public animation_base
 {
     size_t frames_;
+    frame_table table_;
+    std::vector<color> colors_;
 
-    static color hsv_to_rgb(double h, double s, double v)
+  public:
+    static color16 hsv_to_rgb(double h, double s, double v)
     {
         double c = v * s;
         double x = c * (1.0 - std::abs(std::fmod(h / 60.0, 2.0) - 1.0));
@@ -114,80 +257,904 @@ class rainbow_animation : public animation_base
             b = x;
         }
 
-        return { static_cast<uint8_t>((r + m) * 255), static_cast<uint8_t>((g + m) * 255), static_cast<uint8_t>((b + m) * 255) };
+        auto fixed = [](double channel) { return static_cast<uint16_t>(std::lround(channel * 0xFF00)); };
+        return { fixed(r + m), fixed(g + m), fixed(b + m) };
     }
 
-  public:
     rainbow_animation(hid_device_wrapper& dev, std::chrono::milliseconds dur = std::chrono::milliseconds(5000), size_t frames = 100)
         : animation_base(dev, color{ 0, 0, 0 }, dur), frames_(frames)
     {
+        scheduler_.set_period(std::chrono::duration_cast<std::chrono::nanoseconds>(duration_) / frames_);
+        table_ = render_cycle(frames_, device_.zone_count(), [this](size_t frame, size_t zones, color16* out) { render_frame(frames_, frame, zones, out); });
+    }
+
+    static void render_frame(size_t frames, size_t frame, size_t zones, color16* out)
+    {
+        for (size_t i = 0; i < zones; ++i) {
+            double hue = std::fmod((i * 360.0 / zones) + (frame * 360.0 / frames), 360.0);
+            out[i] = hsv_to_rgb(hue, 1.0, 1.0);
+        }
+    }
+
+    static std::unique_ptr<renderer> layer(size_t zones, std::chrono::milliseconds dur = std::chrono::milliseconds(5000), size_t frames = 100)
+    {
+        return std::make_unique<cycle_renderer>(render_cycle(frames, zones, [&](size_t frame, size_t z, color16* out) { render_frame(frames, frame, z, out); }), dur);
     }
 
     void run() override
     {
-        auto delay = duration_ / frames_;
-        size_t zones = device_.zone_count();
+        for (size_t frame = 0; frame < frames_ && !stopped(); frame += scheduler_.wait()) {
+            encoder_.encode(table_.row(frame), colors_);
+            device_.set_colors(colors_);
+        }
+    }
+};
+
+/**
+ * Zones along each edge of the captured area, see ZoneAnalyzer::analyze(), and the monitor the
+ * area is on.
+ */
+struct zone_layout
+{
+    size_t bottom_zones = 10;
+    size_t left_zones = 10;
+    size_t top_zones = 10;
+    size_t right_zones = 10;
+    /** XRandR output name or index to capture, empty for the whole screen; layouts on one monitor share its capture */
+    std::string monitor;
 
-        for (size_t frame = 0; frame < frames_; ++frame) {
-            std::vector<color> colors;
-            colors.reserve(zones);
+    bool operator==(const zone_layout&) const = default;
 
-            for (size_t i = 0; i < zones; ++i) {
-                double hue = std::fmod((i * 360.0 / zones) + (frame * 360.0 / frames_), 360.0);
-                colors.push_back(hsv_to_rgb(hue, 1.0, 1.0));
-            }
+    size_t zone_count() const
+    {
+        return ZoneAnalyzer::zone_count(bottom_zones, left_zones, top_zones, right_zones);
+    }
+};
 
-            device_.set_colors(colors);
-            std::this_thread::sleep_for(delay);
+/** How the screen is captured and analyzed; the zone counts and monitors are per strip, see zone_layout. */
+struct screen_zone_settings
+{
+    float capture_percent = 0.5f;
+    int zone_depth = 50;
+    /** capture and analysis rate */
+    size_t fps = 30;
+    /** LED update rate; above `fps` the output eases between analyzed frames, 0 follows `fps` */
+    size_t output_fps = 0;
+    int sample_stride = 1;
+    bool border_capture = true;
+    bool track_damage = true;
+    /** run capture, analysis and encoding on their own threads; needs `border_capture` */
+    bool pipelined = false;
+    /** print per-stage throughput and queue depth once a second */
+    bool report_stats = false;
+    /** raw video file or "-" for stdin to read instead of the screen, see RawFrameSource; it stands in for every monitor */
+    std::string source;
+    /** threads summing pixels in the analysis stage, including the one running it */
+    size_t analysis_threads = 1;
+    /** share of one core for capture and analysis; above 0, `fps` and `sample_stride` become starting points of a capture_governor */
+    double cpu_budget = 0.0;
+};
+
+/**
+ * One capture and its damage tracking, shared by every zone layout on its monitor.
+ */
+struct capture_source
+{
+    std::string monitor;
+    ScreenCapture capture;
+    std::vector<ImageRect> damage;
+    /** a complete frame was captured, so damage alone can bring the analysis up to date */
+    bool primed = false;
+    /** set by poll(): whether there is anything to capture, and whether only `damage` needs re-reading */
+    bool changed = false;
+    bool incremental = false;
+
+    capture_source(const std::string& m, const std::string& raw) : monitor(m), capture(m, raw)
+    {
+    }
+
+    /** Checks what changed since the last capture; with damage tracking a static desktop costs one event poll. */
+    bool poll(bool track_damage)
+    {
+        incremental = track_damage && capture.poll_damage(damage) && primed;
+        changed = !(incremental && damage.empty());
+        return changed;
+    }
+
+    /** Captures what poll() found, into strip set `buffer` with border capture. */
+    bool grab(const screen_zone_settings& s, int buffer)
+    {
+        bool ok = s.border_capture ? capture.capture_border(s.capture_percent, s.zone_depth, incremental ? &damage : nullptr, buffer) : capture.capture(s.capture_percent);
+        /** after a failed capture its damage is lost, the next one has to be complete */
+        primed = ok;
+        return ok;
+    }
+};
+
+/**
+ * The captures behind a set of zone layouts: one per monitor, opened when the first layout on it
+ * is added and kept open after the last one goes. A raw video source stands in for every
+ * monitor, so there is only one capture then.
+ */
+class capture_sources
+{
+    std::string raw_;
+    std::vector<std::unique_ptr<capture_source>> sources_;
+
+  public:
+    explicit capture_sources(std::string raw = {}) : raw_(std::move(raw))
+    {
+    }
+
+    /** Index of the capture of `monitor`, opening it on first use. */
+    size_t open(const std::string& monitor)
+    {
+        std::string key = raw_.empty() ? monitor : std::string();
+        for (size_t i = 0; i < sources_.size(); ++i) {
+            if (sources_[i]->monitor == key) return i;
         }
+        sources_.push_back(std::make_unique<capture_source>(key, raw_));
+        return sources_.size() - 1;
+    }
+
+    capture_source& operator[](size_t index)
+    {
+        return *sources_[index];
+    }
+
+    const capture_source& operator[](size_t index) const
+    {
+        return *sources_[index];
+    }
+
+    size_t size() const
+    {
+        return sources_.size();
+    }
+
+    /** Makes every capture start over with a complete frame. */
+    void reset()
+    {
+        for (auto& source : sources_)
+            source->primed = false;
     }
 };
 
+/**
+ * Analyzes `layout` from what `source` captured last, from strip set `buffer` with border capture,
+ * re-reading only `damage` when given.
+ */
+inline size_t analyze_layout(ZoneAnalyzer& analyzer, const zone_layout& l, const capture_source& source, const screen_zone_settings& s, int buffer,
+                             const std::vector<ImageRect>* damage, std::span<ZoneColor> out)
+{
+    if (!s.border_capture) return analyzer.analyze(source.capture.image(), l.bottom_zones, l.left_zones, l.top_zones, l.right_zones, out);
+    const BorderStrips& strips = source.capture.border(buffer);
+    if (damage) return analyzer.analyze(strips, l.bottom_zones, l.left_zones, l.top_zones, l.right_zones, *damage, out);
+    return analyzer.analyze(strips, l.bottom_zones, l.left_zones, l.top_zones, l.right_zones, out);
+}
+
 class screen_zone_animation : public animation_base
 {
-    size_t bottom_zones_;
-    size_t left_zones_;
-    size_t top_zones_;
-    size_t right_zones_;
-    float capture_percent_;
-    int zone_depth_;
-    size_t fps_;
+    /** What one capture source contributed to a captured_frame. */
+    struct source_frame
+    {
+        bool captured = false;
+        bool incremental = false;
+        std::vector<ImageRect> damage;
+    };
+
+    /** The strip sets captured for analysis, one entry per capture source; `buffer` < 0 ends the pipeline. */
+    struct captured_frame
+    {
+        int buffer = 0;
+        std::vector<source_frame> sources;
+    };
+
+    /** Analyzed zone colors of every strip group, in groups_ order. */
+    struct zone_frame
+    {
+        std::vector<std::vector<ZoneColor>> zones;
+        bool last = false;
+    };
+
+    /**
+     * Strips sharing a zone layout share its analysis and encoding; only the USB write, done by
+     * each device's own writer thread, is per strip.
+     */
+    struct strip_group
+    {
+        zone_layout layout;
+        /** index into captures_ */
+        size_t source = 0;
+        ZoneAnalyzer analyzer;
+        color_encoder encoder;
+        /** per-frame scratch, sized once so the steady-state loop never allocates */
+        std::vector<ZoneColor> zone_colors;
+        size_t zones = 0;
+        /** zone_colors were updated by the last serial capture */
+        bool fresh = false;
+        std::vector<color> colors;
+        frame_interpolator interpolator;
+        std::vector<hid_device_wrapper*> devices;
+        bool warned = false;
+
+        strip_group(const zone_layout& l, size_t s, int zone_depth, int sample_stride) : layout(l), source(s), analyzer(zone_depth, sample_stride), zone_colors(l.zone_count())
+        {
+            colors.reserve(zone_colors.size());
+        }
+    };
+
+    screen_zone_settings settings_;
+    capture_sources captures_;
+    /** shared by the analyzers of all groups, which all run on the analysis thread */
+    std::unique_ptr<WorkerPool> pool_;
+    hot_path_metrics& metrics_ = hot_path();
+    std::vector<strip_group> groups_;
+
+    /** set when `cpu_budget` is; adjusts capture_period_ns_ and the analyzers' sample stride */
+    std::unique_ptr<capture_governor> governor_;
+    std::atomic<int64_t> capture_period_ns_{ 0 };
+    bool interpolate_ = false;
+
+    /** output frames since start and the one the next capture is due in, for serial interpolation */
+    size_t output_frame_ = 0;
+    size_t next_capture_ = 0;
+    /** paces the LED output when it runs faster than capture in pipelined mode */
+    frame_scheduler output_scheduler_{ std::chrono::milliseconds(33) };
+
+    spsc_ring<captured_frame, ScreenCapture::k_border_buffers> frames_;
+    triple_buffer<zone_frame> zones_;
+    /** the USB write is timed by each device's writer thread, see hid_writer_stats */
+    stage_stats capture_stats_, analysis_stats_, encode_stats_;
+
+    std::chrono::steady_clock::time_point last_report_{};
+
+    /** In serial mode, prints the frame timing once a second when stats are enabled. */
+    void report_timing()
+    {
+        if (!settings_.report_stats) return;
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_report_ < std::chrono::seconds(1)) return;
+        last_report_ = now;
+        std::cerr << "frame ";
+        scheduler_.stats().print(std::cerr);
+    }
+
+    void check_zone_count(strip_group& group, size_t zones) const
+    {
+        if (group.warned) return;
+        group.warned = true;
+
+        // Verify zone count matches LED count
+        for (const hid_device_wrapper* device : group.devices) {
+            if (zones != device->zone_count()) {
+                std::cerr << "Warning: Zone count (" << zones << ") doesn't match LED count (" << device->zone_count() << ")\n";
+            }
+        }
+    }
+
+    /** Strip encoders follow the gamma and dithering configured through encoder(). */
+    void sync_encoders()
+    {
+        for (auto& group : groups_) {
+            if (group.encoder.gamma() != encoder_.gamma() || group.encoder.dither() != encoder_.dither()) group.encoder = encoder_;
+        }
+    }
+
+    bool interpolating() const
+    {
+        return interpolate_;
+    }
+
+    std::chrono::nanoseconds capture_period() const
+    {
+        return std::chrono::nanoseconds(capture_period_ns_.load(std::memory_order_relaxed));
+    }
+
+    /** Follows the governor's sample stride, on the thread that runs the analyzers. */
+    void apply_stride()
+    {
+        if (!governor_) return;
+        int stride = governor_->stride();
+        for (auto& g : groups_) {
+            if (g.analyzer.sample_stride() != stride) g.analyzer.set_sample_stride(stride);
+        }
+    }
+
+    /** Lets the governor evaluate its window and applies a new capture rate, on the capturing thread. */
+    void update_governor()
+    {
+        if (!governor_ || !governor_->update(std::chrono::steady_clock::now(), &std::cerr)) return;
+
+        auto period = std::chrono::nanoseconds(1000000000) / governor_->fps();
+        capture_period_ns_.store(period.count(), std::memory_order_relaxed);
+        /** serial interpolation paces at the output rate and derives its capture cadence from the period */
+        if (!interpolate_ || settings_.pipelined) scheduler_.set_period(period);
+    }
+
+    /** Whether any group takes its zones from capture source `source`; the others are not polled. */
+    bool in_use(size_t source) const
+    {
+        return std::any_of(groups_.begin(), groups_.end(), [&](const strip_group& g) { return g.source == source; });
+    }
+
+    /** Analyzes every group on capture source `source` from strip set `buffer`, re-reading only `damage` when given. */
+    void analyze_source(size_t source, int buffer, const std::vector<ImageRect>* damage)
+    {
+        for (auto& g : groups_) {
+            if (g.source != source) continue;
+            g.zones = timed(metrics_.analyze, [&] { return analyze_layout(g.analyzer, g.layout, captures_[source], settings_, buffer, damage, g.zone_colors); });
+            g.fresh = true;
+            check_zone_count(g, g.zones);
+        }
+    }
+
+    /** Captures and analyzes one frame of every monitor in use; false if nothing changed or capturing failed. */
+    bool capture_and_analyze()
+    {
+        apply_stride();
+        bool changed = false;
+        for (size_t i = 0; i < captures_.size(); ++i) {
+            capture_source& source = captures_[i];
+            if (!in_use(i) || !source.poll(settings_.track_damage)) continue;
+            if (!timed(metrics_.capture, [&] { return source.grab(settings_, 0); })) continue;
+            analyze_source(i, 0, source.incremental ? &source.damage : nullptr);
+            changed = true;
+        }
+        return changed;
+    }
+
+    /** Encodes a group's colors and queues them on its strips; every device writes on its own thread, so strips are written in parallel. */
+    void send_group(strip_group& g, std::span<const ZoneColor> zones)
+    {
+        timed(metrics_.encode, [&] { g.encoder.encode(zones, g.colors); });
+        for (hid_device_wrapper* device : g.devices)
+            device->set_colors(g.colors);
+    }
+
+    /** Sends the group's colors eased to `now`; a settled frame is only repeated while dithering needs every frame. */
+    void send_interpolated(strip_group& g, std::chrono::steady_clock::time_point now)
+    {
+        if (g.interpolator.settled() && !g.encoder.dither()) return;
+
+        std::span<const color16> frame = g.interpolator.sample(now);
+        timed(metrics_.encode, [&] { g.encoder.encode(frame, g.colors); });
+        for (hid_device_wrapper* device : g.devices)
+            device->set_colors(g.colors);
+    }
+
+    /**
+     * One output frame on the calling thread. Without interpolation every frame is a capture ->
+     * analyze -> write cycle; with it, only every output_fps / fps-th frame captures and the
+     * others send the colors eased towards the last analysis.
+     */
+    void step()
+    {
+        bool interpolate = interpolating();
+        if (!interpolate || output_frame_ >= next_capture_) {
+            auto output_period = scheduler_.period();
+            next_capture_ = output_frame_ + std::max<int64_t>(1, (capture_period() + output_period / 2) / output_period);
+
+            auto start = std::chrono::steady_clock::now();
+            bool changed = capture_and_analyze();
+            auto now = std::chrono::steady_clock::now();
+            if (governor_) governor_->record(now - start, changed);
+
+            if (changed) {
+                for (auto& g : groups_) {
+                    if (!g.fresh) continue;
+                    g.fresh = false;
+                    auto zones = std::span<const ZoneColor>(g.zone_colors).first(g.zones);
+                    if (interpolate) {
+                        g.interpolator.set_transition(capture_period());
+                        g.interpolator.retarget(zones, now);
+                    } else {
+                        send_group(g, zones);
+                    }
+                }
+            }
+            update_governor();
+        }
+
+        if (interpolate) {
+            auto now = std::chrono::steady_clock::now();
+            for (auto& g : groups_)
+                send_interpolated(g, now);
+        }
+        output_frame_ += scheduler_.wait();
+        report_timing();
+    }
+
+    /**
+     * Paces the pipeline: grabs the border of every changed monitor into its strip set of the next
+     * free ring slot. Blocks when analysis falls three frames behind instead of dropping frames,
+     * so that the damage carried by each frame always describes the change since the previous one.
+     */
+    void capture_stage()
+    {
+        while (!stop_.load(std::memory_order_relaxed)) {
+            auto tick = std::chrono::steady_clock::now();
+            bool changed = false;
+            for (size_t i = 0; i < captures_.size(); ++i)
+                changed = (in_use(i) && captures_[i].poll(settings_.track_damage)) || changed;
+            /** polling and capturing count against the budget, waiting for a free ring slot does not */
+            auto busy = std::chrono::steady_clock::now() - tick;
+            if (changed) {
+                captured_frame* slot = frames_.write_slot();
+                if (!slot) {
+                    capture_stats_.stalls.fetch_add(1, std::memory_order_relaxed);
+                    frames_.wait_writable();
+                    slot = frames_.write_slot();
+                }
+
+                auto start = std::chrono::steady_clock::now();
+                int buffer = static_cast<int>(frames_.write_index());
+                bool captured = false;
+                slot->buffer = buffer;
+                slot->sources.resize(captures_.size());
+                for (size_t i = 0; i < captures_.size(); ++i) {
+                    capture_source& source = captures_[i];
+                    source_frame& out = slot->sources[i];
+                    out.captured = in_use(i) && source.changed && timed(metrics_.capture, [&] { return source.grab(settings_, buffer); });
+                    if (!out.captured) continue;
+                    out.incremental = source.incremental;
+                    out.damage = source.damage;
+                    captured = true;
+                }
+                if (captured) {
+                    frames_.push();
+                    capture_stats_.record(std::chrono::steady_clock::now() - start);
+                }
+                busy += std::chrono::steady_clock::now() - start;
+            }
+
+            if (governor_) {
+                governor_->record(busy, changed);
+                update_governor();
+            }
+            scheduler_.wait();
+        }
+
+        while (!frames_.write_slot())
+            frames_.wait_writable();
+        frames_.write_slot()->buffer = -1;
+        frames_.push();
+    }
+
+    void analysis_stage()
+    {
+        while (true) {
+            captured_frame* frame = frames_.read_slot();
+            if (!frame) {
+                analysis_stats_.stalls.fetch_add(1, std::memory_order_relaxed);
+                frames_.wait_readable();
+                continue;
+            }
+
+            zone_frame& out = zones_.back();
+            if (frame->buffer < 0) {
+                frames_.pop();
+                out.last = true;
+                zones_.publish();
+                return;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            apply_stride();
+            for (size_t i = 0; i < frame->sources.size(); ++i) {
+                const source_frame& source = frame->sources[i];
+                if (source.captured) analyze_source(i, frame->buffer, source.incremental ? &source.damage : nullptr);
+            }
+            frames_.pop();
+
+            /** buffers cycle, one may still carry the end marker of an earlier run() */
+            out.last = false;
+            out.zones.resize(groups_.size());
+            for (size_t i = 0; i < groups_.size(); ++i)
+                out.zones[i].assign(groups_[i].zone_colors.begin(), groups_[i].zone_colors.begin() + groups_[i].zones);
+            if (!zones_.publish()) analysis_stats_.dropped.fetch_add(1, std::memory_order_relaxed);
+            auto busy = std::chrono::steady_clock::now() - start;
+            analysis_stats_.record(busy);
+            if (governor_) governor_->record_busy(busy);
+        }
+    }
+
+    void write_stage()
+    {
+        while (true) {
+            if (!zones_.acquire()) {
+                encode_stats_.stalls.fetch_add(1, std::memory_order_relaxed);
+                zones_.wait();
+                continue;
+            }
+
+            const zone_frame& frame = zones_.front();
+            if (frame.last) return;
+
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < frame.zones.size(); ++i)
+                send_group(groups_[i], frame.zones[i]);
+            encode_stats_.record(std::chrono::steady_clock::now() - start);
+        }
+    }
+
+    /**
+     * Write stage when the LEDs run faster than capture: paced on its own, it eases towards the
+     * newest analyzed frame whenever one arrives and never waits on analysis.
+     */
+    void output_stage()
+    {
+        output_scheduler_.restart();
+        while (true) {
+            if (zones_.acquire()) {
+                const zone_frame& frame = zones_.front();
+                if (frame.last) return;
+
+                auto now = std::chrono::steady_clock::now();
+                for (size_t i = 0; i < frame.zones.size(); ++i) {
+                    groups_[i].interpolator.set_transition(capture_period());
+                    groups_[i].interpolator.retarget(std::span<const ZoneColor>(frame.zones[i]), now);
+                }
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            for (auto& g : groups_)
+                send_interpolated(g, start);
+            encode_stats_.record(std::chrono::steady_clock::now() - start);
+            output_scheduler_.wait();
+        }
+    }
+
+    void print_stats(double seconds) const
+    {
+        auto line = [&](const char* name, const stage_stats& st) {
+            uint64_t frames = st.frames.load(std::memory_order_relaxed);
+            double busy_ms = frames ? st.busy_ns.load(std::memory_order_relaxed) / 1e6 / frames : 0.0;
+            std::cerr << name << ' ' << frames / seconds << " fps " << busy_ms << " ms/frame " << st.stalls.load(std::memory_order_relaxed) << " stalls "
+                      << st.dropped.load(std::memory_order_relaxed) << " dropped | ";
+        };
+        line("capture", capture_stats_);
+        line("analyze", analysis_stats_);
+        line("encode", encode_stats_);
+        std::cerr << "queue " << frames_.depth() << '/' << frames_.capacity;
+        for (const auto& g : groups_) {
+            for (const hid_device_wrapper* device : g.devices) {
+                const auto& usb = device->writer_stats();
+                uint64_t sent = usb.sent.load(std::memory_order_relaxed);
+                double write_ms = sent ? usb.busy_ns.load(std::memory_order_relaxed) / 1e6 / sent : 0.0;
+                std::cerr << " | write " << sent / seconds << " fps " << write_ms << " ms/frame " << usb.dropped.load(std::memory_order_relaxed) << " dropped "
+                          << usb.suppressed.load(std::memory_order_relaxed) << " suppressed";
+            }
+        }
+        std::cerr << '\n';
+        std::cerr << "frame ";
+        scheduler_.stats().print(std::cerr);
+        if (interpolating()) {
+            std::cerr << "output ";
+            output_scheduler_.stats().print(std::cerr);
+        }
+    }
+
+    /** Derives the capture period, the output pacing and the governor from the rate settings. */
+    void configure_rate()
+    {
+        interpolate_ = settings_.output_fps > settings_.fps;
+        governor_.reset();
+        if (settings_.cpu_budget > 0.0) {
+            capture_governor_settings governed;
+            governed.cpu_budget = settings_.cpu_budget;
+            governed.max_fps = std::max<size_t>(settings_.fps, 1);
+            governed.min_fps = std::min<size_t>(governed.min_fps, governed.max_fps);
+            governor_ = std::make_unique<capture_governor>(governed, settings_.fps, settings_.sample_stride);
+        }
+
+        auto capture_period = std::chrono::nanoseconds(1000000000) / std::max<size_t>(settings_.fps, 1);
+        capture_period_ns_.store(capture_period.count(), std::memory_order_relaxed);
+        scheduler_.set_period(capture_period);
+        if (interpolating()) {
+            /** serial mode paces its loop at the output rate and captures on every n-th frame */
+            auto output_period = std::chrono::nanoseconds(1000000000) / settings_.output_fps;
+            output_scheduler_.set_period(output_period);
+            if (!settings_.pipelined) scheduler_.set_period(output_period);
+        }
+        for (auto& g : groups_)
+            g.interpolator.set_transition(capture_period);
+    }
 
   public:
-    screen_zone_animation(hid_device_wrapper& dev, size_t bottom_zones, size_t left_zones, size_t top_zones, size_t right_zones, float capture_percent = 0.5f, int zone_depth = 50,
-                          size_t fps = 30)
-        : animation_base(dev, color{ 0, 0, 0 }, std::chrono::milliseconds(0)), bottom_zones_(bottom_zones), left_zones_(left_zones), top_zones_(top_zones),
-          right_zones_(right_zones), capture_percent_(capture_percent), zone_depth_(zone_depth), fps_(fps)
+    /** Drives `dev` with the zones of `layout`; further strips join with add_strip(). */
+    screen_zone_animation(hid_device_wrapper& dev, const zone_layout& layout, const screen_zone_settings& settings)
+        : animation_base(dev, color{ 0, 0, 0 }, std::chrono::milliseconds(0)), settings_(settings), captures_(settings.source)
     {
+        if (settings_.pipelined && !settings_.border_capture) throw std::runtime_error("The capture pipeline works on border strips, it cannot capture the full screen");
+        if (settings_.analysis_threads > 1) pool_ = std::make_unique<WorkerPool>(settings_.analysis_threads);
+        configure_rate();
+        add_strip(dev, layout);
     }
 
-    void run() override
+    /** Changes the capture and output rate, see screen_zone_settings; not while run() is active. */
+    void set_rate(size_t fps, size_t output_fps)
+    {
+        settings_.fps = std::max<size_t>(fps, 1);
+        settings_.output_fps = output_fps;
+        configure_rate();
+    }
+
+    /**
+     * Moves a strip to another zone layout; groups left without strips are dropped. Analysis of
+     * the layout starts over with the next complete frame. Not while run() is active.
+     */
+    void set_layout(hid_device_wrapper& dev, const zone_layout& layout)
+    {
+        for (auto& g : groups_)
+            std::erase(g.devices, &dev);
+        std::erase_if(groups_, [](const strip_group& g) { return g.devices.empty(); });
+        add_strip(dev, layout);
+        captures_.reset();
+    }
+
+    /** Starts over with a complete capture: damage since the last run says nothing about what the LEDs show now. */
+    void resume() override
     {
-        static ScreenCapture cap;
-        static ZoneAnalyzer analyzer(zone_depth_);
-        auto delay = std::chrono::milliseconds(1000 / fps_);
+        animation_base::resume();
+        output_scheduler_.restart();
+        output_frame_ = 0;
+        next_capture_ = 0;
+        captures_.reset();
+    }
+
+    /**
+     * Drives another strip. Strips with an identical layout are analyzed once; a new layout on a
+     * monitor already captured costs one more pass over the captured border, one on another
+     * monitor opens a capture of its own. Must be called before run().
+     */
+    void add_strip(hid_device_wrapper& dev, const zone_layout& layout)
+    {
+        auto group = std::find_if(groups_.begin(), groups_.end(), [&](const strip_group& g) { return g.layout == layout; });
+        if (group == groups_.end()) {
+            groups_.emplace_back(layout, captures_.open(layout.monitor), settings_.zone_depth, settings_.sample_stride);
+            groups_.back().analyzer.set_worker_pool(pool_.get());
+            groups_.back().interpolator.set_transition(capture_period());
+            group = groups_.end() - 1;
+        }
+        group->devices.push_back(&dev);
+    }
 
-        if (!cap.capture(capture_percent_)) {
+    /** Number of distinct zone layouts, i.e. analysis passes per frame. */
+    size_t layout_count() const
+    {
+        return groups_.size();
+    }
+
+    /** Number of captures opened, one per monitor. */
+    size_t capture_count() const
+    {
+        return captures_.size();
+    }
+
+    const stage_stats& capture_stats() const
+    {
+        return capture_stats_;
+    }
+
+    const stage_stats& analysis_stats() const
+    {
+        return analysis_stats_;
+    }
+
+    /** Encoding and queueing the colors for the writer threads. */
+    const stage_stats& encode_stats() const
+    {
+        return encode_stats_;
+    }
+
+    /** Captured frames waiting for analysis. */
+    size_t queue_depth() const
+    {
+        return frames_.depth();
+    }
+
+    /**
+     * Serial mode handles a single frame per call. Pipelined mode overlaps capture of frame N+1,
+     * analysis of frame N and the USB write of frame N-1 and only returns after stop(); after
+     * resume() it can be run again.
+     */
+    void run() override
+    {
+        sync_encoders();
+        if (!settings_.pipelined) {
+            step();
             return;
         }
 
-        auto zones = analyzer.analyze(cap.data(), cap.width(), cap.height(), cap.bytes_per_pixel(), bottom_zones_, left_zones_, top_zones_, right_zones_);
+        std::thread capture([this] { capture_stage(); });
+        std::thread analysis([this] { analysis_stage(); });
+        std::thread write([this] {
+            if (interpolating()) {
+                output_stage();
+            } else {
+                write_stage();
+            }
+        });
 
-        // Verify zone count matches LED count
-        size_t total_zones = bottom_zones_ + left_zones_ + top_zones_ + right_zones_;
-        if (zones.size() != device_.zone_count()) {
-            std::cerr << "Warning: Zone count (" << zones.size() << ") doesn't match LED count (" << device_.zone_count() << ")\n";
+        /** stop() wakes this thread right away, so a stopped pipeline hands over within a frame */
+        auto started = std::chrono::steady_clock::now();
+        auto next_report = started + std::chrono::seconds(1);
+        while (!stopped()) {
+            if (!settings_.report_stats) {
+                stop_.wait(false, std::memory_order_relaxed);
+                continue;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            if (std::chrono::steady_clock::now() < next_report) continue;
+            next_report += std::chrono::seconds(1);
+            print_stats(std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
         }
 
-        std::vector<color> colors;
-        colors.reserve(zones.size());
+        capture.join();
+        analysis.join();
+        write.join();
+    }
+};
 
-        for (const auto& zone : zones) {
-            colors.push_back({ static_cast<uint8_t>(zone.r * 255), static_cast<uint8_t>(zone.g * 255), static_cast<uint8_t>(zone.b * 255) });
+/**
+ * The screen zone colors behind any number of compositor layers on any number of strips: per
+ * capture period, one capture per monitor and one analysis per distinct layout, however many
+ * layers show them. Captures on the frame loop's thread, in the first render() that finds a
+ * capture due, and when `output_fps` exceeds `fps` eases between analyses like the serial
+ * screen_zone_animation. Not thread-safe: every layer using it renders on one frame loop, as
+ * the strips of a compositor_animation do.
+ */
+class screen_layers
+{
+    using clock = renderer::clock;
+
+    /** One distinct layout, its analysis and the colors eased towards it. */
+    struct layout_state
+    {
+        zone_layout layout;
+        /** index into captures_ */
+        size_t source;
+        ZoneAnalyzer analyzer;
+        std::vector<ZoneColor> zone_colors;
+        size_t zones = 0;
+        frame_interpolator interpolator;
+
+        layout_state(const zone_layout& l, size_t s, int zone_depth, int sample_stride) : layout(l), source(s), analyzer(zone_depth, sample_stride), zone_colors(l.zone_count())
+        {
         }
+    };
 
-        device_.set_colors(colors);
-        std::this_thread::sleep_for(delay);
+    screen_zone_settings settings_;
+    capture_sources captures_;
+    std::unique_ptr<WorkerPool> pool_;
+    std::vector<layout_state> layouts_;
+    hot_path_metrics& metrics_ = hot_path();
+    std::chrono::nanoseconds period_;
+    clock::time_point next_capture_{};
+
+  public:
+    /** Takes the capture settings and rates from `settings`; nothing is captured until a layout is added. */
+    explicit screen_layers(const screen_zone_settings& settings)
+        : settings_(settings), captures_(settings.source), period_(std::chrono::nanoseconds(1000000000) / std::max<size_t>(settings.fps, 1))
+    {
+        if (settings_.analysis_threads > 1) pool_ = std::make_unique<WorkerPool>(settings_.analysis_threads);
+    }
+
+    /** Index of `layout` for sample(), analyzed from the next capture on; identical layouts share one index. */
+    size_t add_layout(const zone_layout& layout)
+    {
+        for (size_t i = 0; i < layouts_.size(); ++i) {
+            if (layouts_[i].layout == layout) return i;
+        }
+        layouts_.emplace_back(layout, captures_.open(layout.monitor), settings_.zone_depth, settings_.sample_stride);
+        layouts_.back().analyzer.set_worker_pool(pool_.get());
+        if (settings_.output_fps > settings_.fps) layouts_.back().interpolator.set_transition(period_);
+        return layouts_.size() - 1;
+    }
+
+    /** Captures and analyzes every monitor that changed if a capture is due at `now`. */
+    void update(clock::time_point now)
+    {
+        /** due a quarter period early, so jitter of the frame loop does not skip a capture */
+        if (now < next_capture_ - period_ / 4) return;
+        next_capture_ = std::max(next_capture_ + period_, now);
+
+        for (size_t i = 0; i < captures_.size(); ++i) {
+            capture_source& source = captures_[i];
+            if (!source.poll(settings_.track_damage)) continue;
+            if (!timed(metrics_.capture, [&] { return source.grab(settings_, 0); })) continue;
+            for (auto& l : layouts_) {
+                if (l.source != i) continue;
+                l.zones = timed(metrics_.analyze, [&] { return analyze_layout(l.analyzer, l.layout, source, settings_, 0, source.incremental ? &source.damage : nullptr, l.zone_colors); });
+                l.interpolator.retarget(std::span<const ZoneColor>(l.zone_colors).first(l.zones), now);
+            }
+        }
+    }
+
+    /** The colors of layout `layout` at `now`. */
+    std::span<const color16> sample(size_t layout, clock::time_point now)
+    {
+        return layouts_[layout].interpolator.sample(now);
+    }
+
+    /** Number of captures opened, one per monitor. */
+    size_t capture_count() const
+    {
+        return captures_.size();
+    }
+};
+
+/** The screen zone colors of one layout as a compositor layer, see screen_layers. */
+class screen_renderer : public renderer
+{
+    std::shared_ptr<screen_layers> screen_;
+    size_t layout_;
+
+  public:
+    screen_renderer(std::shared_ptr<screen_layers> screen, const zone_layout& layout) : screen_(std::move(screen)), layout_(screen_->add_layout(layout))
+    {
+    }
+
+    void render(clock::time_point now, std::span<color16> out) override
+    {
+        screen_->update(now);
+        std::span<const color16> frame = screen_->sample(layout_, now);
+        size_t zones = std::min(frame.size(), out.size());
+        std::copy_n(frame.begin(), zones, out.begin());
+        std::fill(out.begin() + zones, out.end(), color16{ 0, 0, 0 });
+    }
+};
+
+/**
+ * Drives strips from stacks of layers on a single frame loop: however many effects are stacked,
+ * a frame is one compose, one encode and one queued write per strip, and the screen layers of
+ * all strips can share one screen_layers.
+ */
+class compositor_animation : public animation_base
+{
+    struct strip
+    {
+        hid_device_wrapper* device;
+        compositor layers;
+        std::vector<color16> frame;
+        color_encoder encoder;
+        std::vector<color> colors;
+    };
+
+    std::vector<strip> strips_;
+
+  public:
+    compositor_animation(hid_device_wrapper& dev, compositor layers, size_t fps = 30) : animation_base(dev, color{ 0, 0, 0 }, std::chrono::milliseconds(0))
+    {
+        scheduler_.set_period(std::chrono::nanoseconds(1000000000) / std::max<size_t>(fps, 1));
+        add_strip(dev, std::move(layers));
+    }
+
+    /** Drives another strip with its own stack from the same frame loop. Must be called before run(). */
+    void add_strip(hid_device_wrapper& dev, compositor layers)
+    {
+        strips_.push_back({ &dev, std::move(layers), std::vector<color16>(dev.zone_count()), encoder_, {} });
+    }
+
+    compositor& layers(size_t strip = 0)
+    {
+        return strips_[strip].layers;
+    }
+
+    /** Composes, encodes and queues one frame on every strip, then waits for the next. */
+    void run() override
+    {
+        auto now = renderer::clock::now();
+        for (auto& s : strips_) {
+            /** strip encoders follow the gamma and dithering configured through encoder() */
+            if (s.encoder.gamma() != encoder_.gamma() || s.encoder.dither() != encoder_.dither()) s.encoder = encoder_;
+            s.layers.compose(now, s.frame);
+            s.encoder.encode(std::span<const color16>(s.frame), s.colors);
+            s.device->set_colors(s.colors);
+        }
+        scheduler_.wait();
     }
 };
 
@@ -1,24 +1,57 @@
 #pragma once
+#include "image.hpp"
 #include <cstdint>
 #include <memory>
+#include <string>
+#include <vector>
 
 class ScreenCaptureImpl;
+class RawFrameSource;
 
 class ScreenCapture
 {
   public:
-    ScreenCapture();
+    /**
+     * Captures from the XRandR output `monitor`, given by name (e.g. "DP-1") or as the index among
+     * enabled outputs, or from the whole root window if it is empty. The monitor's geometry is
+     * followed through hotplug and mode changes; while it is disconnected capturing fails.
+     *
+     * A non-empty `source` reads frames from a raw video file or stdin instead, see
+     * RawFrameSource; no display is opened then and `monitor` is ignored.
+     */
+    explicit ScreenCapture(const std::string& monitor = {}, const std::string& source = {});
     ~ScreenCapture();
 
     ScreenCapture(const ScreenCapture&) = delete;
     ScreenCapture& operator=(const ScreenCapture&) = delete;
 
     bool capture(float percent = 1.0f);
+
+    /** Number of independent strip sets capture_border() can fill, see `buffer`. */
+    static constexpr int k_border_buffers = 3;
+
+    /**
+     * Captures only the `depth`-pixel edges of the `percent` rectangle into strip set `buffer`, see border().
+     * With `damage`, strips that none of the areas touch keep their previous contents.
+     */
+    bool capture_border(float percent, int depth, const std::vector<ImageRect>* damage = nullptr, int buffer = 0);
+    const BorderStrips& border(int buffer = 0) const;
+
+    /**
+     * Collects the areas drawn to since the last call, in capture coordinates.
+     * Returns false when the platform cannot track damage and every frame must be treated as changed.
+     */
+    bool poll_damage(std::vector<ImageRect>& damage);
+
     uint8_t* data() const;
     int width() const;
     int height() const;
     int bytes_per_pixel() const;
 
+    /** The frame of the last capture() with its real row stride and pixel format. */
+    ImageView image() const;
+
   private:
     std::unique_ptr<ScreenCaptureImpl> impl_;
+    std::unique_ptr<RawFrameSource> raw_;
 };
\ No newline at end of file
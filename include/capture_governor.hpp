@@ -0,0 +1,147 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace led
+{
+
+struct capture_governor_settings
+{
+    /** share of one core that capture and analysis together may use, e.g. 0.02 for 2% */
+    double cpu_budget = 0.02;
+    size_t min_fps = 5;
+    size_t max_fps = 60;
+    /** coarsest sample stride the governor may fall back to */
+    int max_stride = 8;
+    /** how often measurements are evaluated */
+    std::chrono::milliseconds window{ 1000 };
+};
+
+/**
+ * Feedback controller for the capture loop. Once per window it compares the time spent in
+ * capture and analysis against the CPU budget and the share of frames whose content changed:
+ *
+ *  - over budget, the sample stride is doubled first (a quarter of the pixels) and only when it
+ *    is at its maximum the capture rate is scaled down;
+ *  - well under budget, the rate is raised up to what the activity asks for, then the stride is
+ *    halved again;
+ *  - a mostly static screen lowers the rate towards min_fps, a busy one raises it towards max_fps.
+ *
+ * record() may be called from any thread, update() from one thread only.
+ */
+class capture_governor
+{
+    using clock = std::chrono::steady_clock;
+
+    capture_governor_settings settings_;
+    std::atomic<size_t> fps_;
+    std::atomic<int> stride_;
+
+    std::atomic<uint64_t> busy_ns_{ 0 };
+    std::atomic<uint64_t> ticks_{ 0 };
+    std::atomic<uint64_t> changed_{ 0 };
+    clock::time_point window_start_ = clock::now();
+
+    /** the rate a fully active screen gets, scaled down linearly with the share of changed frames */
+    size_t wanted_fps(double activity) const
+    {
+        double fps = settings_.min_fps + (static_cast<double>(settings_.max_fps) - settings_.min_fps) * activity;
+        return std::clamp(static_cast<size_t>(fps + 0.5), settings_.min_fps, settings_.max_fps);
+    }
+
+  public:
+    capture_governor(const capture_governor_settings& settings, size_t fps, int stride)
+        : settings_(settings), fps_(std::clamp(fps, settings.min_fps, settings.max_fps)), stride_(std::clamp(stride, 1, settings.max_stride))
+    {
+        settings_.min_fps = std::max<size_t>(1, std::min(settings_.min_fps, settings_.max_fps));
+        settings_.max_stride = std::max(1, settings_.max_stride);
+    }
+
+    size_t fps() const
+    {
+        return fps_.load(std::memory_order_relaxed);
+    }
+
+    int stride() const
+    {
+        return stride_.load(std::memory_order_relaxed);
+    }
+
+    /** One capture tick: the capture and analysis time it cost and whether the content changed. */
+    void record(clock::duration busy, bool changed)
+    {
+        busy_ns_.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(busy).count(), std::memory_order_relaxed);
+        ticks_.fetch_add(1, std::memory_order_relaxed);
+        if (changed) changed_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /** Time spent in a stage that runs only for changed frames, e.g. analysis on its own thread. */
+    void record_busy(clock::duration busy)
+    {
+        busy_ns_.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(busy).count(), std::memory_order_relaxed);
+    }
+
+    /**
+     * Evaluates the finished window, if any. Returns true when the rate or the stride changed;
+     * every change is written to `log` with the measurements that caused it.
+     */
+    bool update(clock::time_point now, std::ostream* log)
+    {
+        auto elapsed = now - window_start_;
+        if (elapsed < settings_.window) return false;
+        window_start_ = now;
+
+        uint64_t busy_ns = busy_ns_.exchange(0, std::memory_order_relaxed);
+        uint64_t ticks = ticks_.exchange(0, std::memory_order_relaxed);
+        uint64_t changed = changed_.exchange(0, std::memory_order_relaxed);
+        if (ticks == 0) return false;
+
+        double usage = busy_ns / static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        double activity = static_cast<double>(changed) / ticks;
+        double budget = settings_.cpu_budget;
+        size_t fps = this->fps(), wanted = wanted_fps(activity);
+        int stride = this->stride();
+        size_t new_fps = fps;
+        int new_stride = stride;
+        const char* reason = nullptr;
+
+        if (usage > budget) {
+            if (stride < settings_.max_stride) {
+                new_stride = std::min(stride * 2, settings_.max_stride);
+                reason = "over budget, coarser sampling";
+            } else {
+                new_fps = std::max(settings_.min_fps, static_cast<size_t>(fps * budget / usage * 0.9));
+                reason = "over budget, lower rate";
+            }
+        } else if (fps > wanted + wanted / 4) {
+            /** rate changes need a 25% difference, so the noise of a short window does not make the rate hunt */
+            new_fps = wanted;
+            reason = "static content, lower rate";
+        } else if (usage < budget * 0.5) {
+            /** cost scales about linearly with the rate, keep 20% headroom */
+            size_t affordable = usage > 0.0 ? static_cast<size_t>(fps * budget * 0.8 / usage) : settings_.max_fps;
+            if (wanted > fps + fps / 4 && affordable > fps) {
+                new_fps = std::min(wanted, affordable);
+                reason = "under budget, higher rate";
+            } else if (stride > 1 && usage * 4 < budget * 0.8) {
+                new_stride = stride / 2;
+                reason = "under budget, finer sampling";
+            }
+        }
+
+        if (new_fps == fps && new_stride == stride) return false;
+        fps_.store(new_fps, std::memory_order_relaxed);
+        stride_.store(new_stride, std::memory_order_relaxed);
+        if (log) {
+            *log << "capture governor: cpu " << usage * 100.0 << "% (budget " << budget * 100.0 << "%) activity " << activity * 100.0 << "% over " << ticks
+                 << " ticks: " << reason << ", fps " << fps << " -> " << new_fps << ", stride " << stride << " -> " << new_stride << '\n';
+        }
+        return true;
+    }
+};
+
+} // namespace led
@@ -4,12 +4,40 @@
 namespace led
 {
 
+/**
+ * A color with 8 fractional bits per channel (8.8 fixed point, 255 == 0xFF00), so scaled and
+ * averaged colors keep their sub-LSB precision until they are quantized for the device.
+ */
+struct color16
+{
+    uint16_t r, g, b;
+};
+
 struct color
 {
     uint8_t r, g, b;
 
     color(uint8_t red = 0, uint8_t green = 0, uint8_t blue = 0);
     color scaled(double brightness) const;
+
+    /** Scales by `level` / 65536 without rounding away the fraction. */
+    color16 scaled_fine(uint32_t level) const
+    {
+        return { static_cast<uint16_t>(r * level >> 8), static_cast<uint16_t>(g * level >> 8), static_cast<uint16_t>(b * level >> 8) };
+    }
+
+    color16 widened() const
+    {
+        return { static_cast<uint16_t>(r << 8), static_cast<uint16_t>(g << 8), static_cast<uint16_t>(b << 8) };
+    }
 };
 
-} // namespace led
\ No newline at end of file
+/** Converts a 0..1 brightness to the fixed-point level taken by color::scaled_fine(). */
+inline uint32_t brightness_level(double brightness)
+{
+    if (brightness <= 0.0) return 0;
+    if (brightness >= 1.0) return 65536;
+    return static_cast<uint32_t>(brightness * 65536.0);
+}
+
+} // namespace led
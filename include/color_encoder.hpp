@@ -0,0 +1,102 @@
+#pragma once
+#include "color.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace led
+{
+
+/**
+ * Turns 8.8 fixed-point colors into the 8-bit values sent to the device: a precomputed gamma
+ * table maps linear input to LED output, and optional temporal dithering carries each channel's
+ * rounding remainder into the next frame, so slow fades at low brightness step through
+ * fractional levels instead of visibly banding.
+ */
+class color_encoder
+{
+    /** 12-bit input index (the top bits of an 8.8 value) to 8.8 output, plus one entry to interpolate towards */
+    static constexpr size_t k_lut_bits = 12;
+    static constexpr uint32_t k_frac_bits = 16 - k_lut_bits;
+
+    std::array<uint16_t, (size_t(1) << k_lut_bits) + 1> lut_{};
+    double gamma_ = 1.0;
+    bool dither_ = false;
+    std::vector<uint8_t> residual_;
+
+    template <bool Dither>
+    static uint8_t quantize(const uint16_t* lut, uint16_t value, uint8_t& residual)
+    {
+        /** linear interpolation between entries keeps the low input bits for the dither */
+        uint32_t index = value >> k_frac_bits;
+        uint32_t frac = value & ((1u << k_frac_bits) - 1);
+        uint32_t v = (lut[index] * ((1u << k_frac_bits) - frac) + lut[index + 1] * frac) >> k_frac_bits;
+
+        if constexpr (Dither) {
+            v += residual;
+            residual = static_cast<uint8_t>(v & 0xFF);
+        } else {
+            v += 0x80;
+        }
+        v >>= 8;
+        return static_cast<uint8_t>(v > 0xFF ? 0xFF : v);
+    }
+
+    template <bool Dither, typename C>
+    void encode_frame(std::span<const C> in, color* out)
+    {
+        const uint16_t* lut = lut_.data();
+        uint8_t* residual = residual_.data();
+        for (size_t i = 0; i < in.size(); ++i, residual += 3) {
+            uint8_t r = quantize<Dither>(lut, in[i].r, residual[0]);
+            uint8_t g = quantize<Dither>(lut, in[i].g, residual[1]);
+            uint8_t b = quantize<Dither>(lut, in[i].b, residual[2]);
+            out[i].r = r;
+            out[i].g = g;
+            out[i].b = b;
+        }
+    }
+
+  public:
+    explicit color_encoder(double gamma = 1.0, bool dither = false);
+
+    /** Rebuilds the lookup table for `out = in ^ gamma`; 1.0 passes colors through unchanged. */
+    void set_gamma(double gamma);
+
+    double gamma() const
+    {
+        return gamma_;
+    }
+
+    void set_dither(bool dither)
+    {
+        dither_ = dither;
+        residual_.clear();
+    }
+
+    bool dither() const
+    {
+        return dither_;
+    }
+
+    /**
+     * Encodes one frame into `out`, reusing its storage. `C` is any type with 8.8 fixed-point
+     * `r`, `g` and `b` members. Frames of a constant size do not allocate.
+     */
+    template <typename C>
+    void encode(std::span<const C> in, std::vector<color>& out)
+    {
+        out.resize(in.size());
+        if (residual_.size() != in.size() * 3) residual_.assign(in.size() * 3, 0x80);
+
+        if (dither_) {
+            encode_frame<true>(in, out.data());
+        } else {
+            encode_frame<false>(in, out.data());
+        }
+    }
+};
+
+} // namespace led
@@ -0,0 +1,91 @@
+#pragma once
+#include "color.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace led
+{
+
+/**
+ * A source of LED colors that does not own a device: it draws the frame for a point in time into
+ * whatever span it is given, so several of them can be stacked by a compositor and driven by one
+ * frame loop.
+ */
+class renderer
+{
+  public:
+    using clock = std::chrono::steady_clock;
+
+    virtual ~renderer() = default;
+
+    /** Writes the colors at `now` into every element of `out`. Called with steadily increasing times. */
+    virtual void render(clock::time_point now, std::span<color16> out) = 0;
+};
+
+/**
+ * How a layer is combined with the layers below it. Channels are 8.8 fixed point with 0xFF00 as
+ * full brightness; `multiply` treats that as one, `add` saturates there.
+ */
+enum class blend_mode
+{
+    alpha,
+    add,
+    multiply,
+    max
+};
+
+/** Full opacity, the scale of brightness_level(). */
+constexpr uint32_t k_opaque = 65536;
+
+/**
+ * Blends `count` 8.8 channels of `src` into `dst` and mixes the result with the old `dst` by
+ * `opacity` / 65536. Channels are blended independently, so a span of color16 is passed as three
+ * times as many channels. Every implementation produces exactly the same values.
+ */
+using blend_kernel = void (*)(uint16_t* dst, const uint16_t* src, size_t count, uint32_t opacity);
+
+blend_kernel blend_kernel_scalar(blend_mode mode);
+blend_kernel blend_kernel_sse2(blend_mode mode);
+blend_kernel blend_kernel_avx2(blend_mode mode);
+
+/** The widest kernel the CPU supports. */
+blend_kernel select_blend_kernel(blend_mode mode);
+
+/**
+ * Stacks renderers bottom to top. Each frame costs one render per layer plus one SIMD pass over
+ * the LED array per layer above an opaque alpha base, which is rendered in place. The scratch
+ * buffer is sized once, so frames of a constant size do not allocate.
+ */
+class compositor
+{
+    struct layer
+    {
+        std::unique_ptr<renderer> source;
+        blend_mode mode;
+        uint32_t opacity;
+        blend_kernel kernel;
+    };
+
+    std::vector<layer> layers_;
+    std::vector<color16> scratch_;
+
+  public:
+    /** Puts `source` on top; `opacity` is 0 (hidden) to k_opaque. */
+    void add_layer(std::unique_ptr<renderer> source, blend_mode mode = blend_mode::alpha, uint32_t opacity = k_opaque);
+
+    size_t layer_count() const
+    {
+        return layers_.size();
+    }
+
+    void set_opacity(size_t layer, uint32_t opacity);
+
+    /** Renders every layer at `now` and blends them into `out`; without layers `out` is black. */
+    void compose(renderer::clock::time_point now, std::span<color16> out);
+};
+
+} // namespace led
@@ -0,0 +1,93 @@
+#pragma once
+#include "animations.hpp"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace led
+{
+
+enum class animation_mode
+{
+    solid,
+    breathing,
+    wave,
+    rainbow,
+    screen_zones
+};
+
+/** What the daemon shows when it starts; commands change all of it later. */
+struct daemon_settings
+{
+    animation_mode mode = animation_mode::solid;
+    color base_color{ 255, 255, 255 };
+    /** one layout and monitor per strip, the last one repeats for any further strips */
+    std::vector<zone_layout> layouts{ zone_layout{} };
+    screen_zone_settings screen;
+    double gamma = 1.0;
+    bool dither = false;
+    overrun_policy overrun = overrun_policy::skip;
+    bool report_stats = false;
+};
+
+/**
+ * Keeps the strips, the screen capture and the zone analyzers open across mode changes and
+ * drives the current animation on its own threads. Commands (see execute()) prepare the next
+ * animation while the current one keeps running and then hand over between two frames.
+ *
+ * The screen zone animation is created on first use and kept when another mode takes over, so
+ * returning to it costs neither a new X connection nor new SHM buffers.
+ */
+class control_daemon
+{
+    std::vector<hid_device_wrapper*> devices_;
+    daemon_settings settings_;
+
+    std::unique_ptr<screen_zone_animation> screen_;
+    /** animations of the current mode other than screen_, one per strip */
+    std::vector<std::unique_ptr<animation_base>> anims_;
+    std::vector<std::thread> threads_;
+    bool finished_ = false;
+
+    zone_layout layout_of(size_t strip) const;
+    void configure(animation_base& anim) const;
+    screen_zone_animation& screen();
+
+    void stop();
+    void start();
+    void show(animation_mode mode);
+
+    std::string set_zones(const std::string& arguments);
+    std::string set_fps(const std::string& arguments);
+    std::string status() const;
+
+  public:
+    /** Starts showing `settings.mode` on `devices`, which must be initialized and outlive the daemon. */
+    control_daemon(std::vector<hid_device_wrapper*> devices, daemon_settings settings);
+    ~control_daemon();
+
+    control_daemon(const control_daemon&) = delete;
+    control_daemon& operator=(const control_daemon&) = delete;
+
+    /**
+     * Runs one command and returns the reply, "ok" or "error: <reason>". Commands:
+     *
+     *   mode solid|breathing|wave|rainbow|reactive
+     *   color r,g,b                      base color of solid, breathing and wave
+     *   zones bottom,left,top,right [n]  layout of strip n, or of every strip
+     *   fps capture [output]             rates of the screen zone animation
+     *   status
+     *   quit
+     */
+    std::string execute(std::string_view command);
+
+    /** True after "quit". */
+    bool finished() const
+    {
+        return finished_;
+    }
+};
+
+} // namespace led
@@ -0,0 +1,57 @@
+#pragma once
+#include <chrono>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace led
+{
+
+/**
+ * Line based command socket of the daemon. Every line a client sends is one command, answered
+ * with exactly one line. Clients are served from the thread calling poll(), one command at a
+ * time, so the handler never runs concurrently with itself.
+ */
+class control_server
+{
+    struct client
+    {
+        int fd = -1;
+        std::string pending;
+    };
+
+    std::string path_;
+    int listen_fd_ = -1;
+    std::vector<client> clients_;
+
+    void close_client(size_t index);
+
+  public:
+    /** Longest accepted command; a client sending a longer line is disconnected. */
+    static constexpr size_t k_max_line = 1024;
+
+    using handler = std::function<std::string(std::string_view command)>;
+
+    /**
+     * Listens on the Unix domain socket at `path`, replacing a stale socket left behind by an
+     * earlier run. The socket is only accessible to the current user. Throws std::runtime_error
+     * if it cannot be created.
+     */
+    explicit control_server(std::string path);
+    ~control_server();
+
+    control_server(const control_server&) = delete;
+    control_server& operator=(const control_server&) = delete;
+
+    /** Waits up to `timeout` for connections and commands and answers every complete line with `handle`. */
+    void poll(std::chrono::milliseconds timeout, const handler& handle);
+};
+
+/**
+ * Sends one command to the daemon listening at `path` and returns its reply without the line
+ * break. Throws std::runtime_error if the daemon cannot be reached.
+ */
+std::string send_control_command(const std::string& path, std::string_view command);
+
+} // namespace led
@@ -0,0 +1,21 @@
+#pragma once
+
+/**
+ * Runtime CPU feature checks for the SIMD kernels. Kernels for wider instruction sets are
+ * compiled with NLCTL_TARGET so the rest of the build keeps the baseline ISA, and are only
+ * called after the matching check passed.
+ */
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NLCTL_X86 1
+#endif
+
+#if defined(NLCTL_X86) && (defined(__GNUC__) || defined(__clang__))
+#define NLCTL_TARGET(isa) __attribute__((target(isa)))
+#else
+#define NLCTL_TARGET(isa)
+#endif
+
+/** False on every CPU that is not x86. */
+bool cpu_has_sse2();
+bool cpu_has_avx2();
@@ -0,0 +1,90 @@
+#pragma once
+#include "color.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace led
+{
+
+/**
+ * Eases the LED colors towards each newly analyzed frame, so that the output can run at a higher
+ * rate than capture. A new target is approached linearly over one transition, starting from
+ * whatever is shown at that moment, so a target that arrives mid-transition never makes the
+ * output jump. This trades one capture period of latency for motion without visible steps.
+ */
+class frame_interpolator
+{
+    using clock = std::chrono::steady_clock;
+
+    std::vector<color16> from_, to_, out_;
+    clock::time_point start_{};
+    std::chrono::nanoseconds transition_{ 0 };
+    bool settled_ = true;
+
+  public:
+    explicit frame_interpolator(std::chrono::nanoseconds transition = {}) : transition_(transition)
+    {
+    }
+
+    void set_transition(std::chrono::nanoseconds transition)
+    {
+        transition_ = transition;
+    }
+
+    /**
+     * Starts a transition towards `target`. `C` is any type with 8.8 fixed-point `r`, `g` and
+     * `b` members. A frame of a different size is shown as is. Frames of a constant size do not
+     * allocate.
+     */
+    template <typename C>
+    void retarget(std::span<const C> target, clock::time_point now)
+    {
+        bool resized = target.size() != out_.size();
+        to_.resize(target.size());
+        for (size_t i = 0; i < target.size(); ++i)
+            to_[i] = { target[i].r, target[i].g, target[i].b };
+
+        if (resized) {
+            out_ = to_;
+            from_ = to_;
+            settled_ = false;
+            start_ = now - transition_;
+            return;
+        }
+        std::copy(out_.begin(), out_.end(), from_.begin());
+        start_ = now;
+        settled_ = false;
+    }
+
+    /** True once the last target has been reached and been returned by sample(). */
+    bool settled() const
+    {
+        return settled_;
+    }
+
+    /** The colors to show at `now`. */
+    std::span<const color16> sample(clock::time_point now)
+    {
+        if (settled_) return out_;
+
+        auto elapsed = now - start_;
+        if (elapsed >= transition_ || transition_.count() <= 0) {
+            std::copy(to_.begin(), to_.end(), out_.begin());
+            settled_ = true;
+            return out_;
+        }
+
+        /** 16-bit blend factor, exact enough for 8.8 channels and free of floating point per LED */
+        int64_t alpha = std::max<int64_t>(0, elapsed.count()) * 65536 / transition_.count();
+        auto mix = [alpha](uint16_t a, uint16_t b) { return static_cast<uint16_t>(a + (((static_cast<int64_t>(b) - a) * alpha) >> 16)); };
+        for (size_t i = 0; i < out_.size(); ++i)
+            out_[i] = { mix(from_[i].r, to_[i].r), mix(from_[i].g, to_[i].g), mix(from_[i].b, to_[i].b) };
+        return out_;
+    }
+};
+
+} // namespace led
@@ -0,0 +1,177 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <thread>
+
+namespace led
+{
+
+/**
+ * Distribution of the time between consecutive frames plus deadline bookkeeping. Written by the
+ * thread that owns the scheduler, safe to read from any other thread.
+ */
+struct frame_stats
+{
+    static constexpr int k_bucket_us = 100;
+    /** intervals longer than k_buckets * k_bucket_us all land in the last bucket */
+    static constexpr size_t k_buckets = 1000;
+
+    std::array<std::atomic<uint32_t>, k_buckets + 1> histogram{};
+    std::atomic<uint64_t> frames{ 0 };
+    std::atomic<uint64_t> interval_ns{ 0 };
+    /** frames whose work was still running when their deadline passed */
+    std::atomic<uint64_t> missed{ 0 };
+    /** frame slots given up to get back on the deadline grid */
+    std::atomic<uint64_t> skipped{ 0 };
+    /** how long after its deadline a frame actually started */
+    std::atomic<uint64_t> late_ns{ 0 };
+    std::atomic<uint64_t> late_ns_max{ 0 };
+
+    void record(std::chrono::steady_clock::duration interval, std::chrono::steady_clock::duration late)
+    {
+        auto interval_count = std::chrono::duration_cast<std::chrono::nanoseconds>(interval).count();
+        auto late_count = static_cast<uint64_t>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(late).count()));
+        size_t bucket = std::min<size_t>(static_cast<size_t>(interval_count / (k_bucket_us * 1000)), k_buckets);
+
+        histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+        frames.fetch_add(1, std::memory_order_relaxed);
+        interval_ns.fetch_add(interval_count, std::memory_order_relaxed);
+        late_ns.fetch_add(late_count, std::memory_order_relaxed);
+        if (late_count > late_ns_max.load(std::memory_order_relaxed)) late_ns_max.store(late_count, std::memory_order_relaxed);
+    }
+
+    double mean_ms() const
+    {
+        uint64_t n = frames.load(std::memory_order_relaxed);
+        return n ? interval_ns.load(std::memory_order_relaxed) / 1e6 / n : 0.0;
+    }
+
+    /** Upper edge of the bucket holding the p-th fraction (0..1) of frame intervals. */
+    double percentile_ms(double p) const
+    {
+        uint64_t n = frames.load(std::memory_order_relaxed);
+        if (n == 0) return 0.0;
+
+        uint64_t target = static_cast<uint64_t>(p * (n - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i <= k_buckets; ++i) {
+            seen += histogram[i].load(std::memory_order_relaxed);
+            if (seen >= target) return (i + 1) * k_bucket_us / 1000.0;
+        }
+        return (k_buckets + 1) * k_bucket_us / 1000.0;
+    }
+
+    void print(std::ostream& out) const
+    {
+        uint64_t n = frames.load(std::memory_order_relaxed);
+        double mean = mean_ms();
+        out << "frames " << n << " mean " << mean << " ms (" << (mean > 0.0 ? 1000.0 / mean : 0.0) << " fps) p50 " << percentile_ms(0.5) << " p99 "
+            << percentile_ms(0.99) << " ms | late avg " << (n ? late_ns.load(std::memory_order_relaxed) / 1e6 / n : 0.0) << " max "
+            << late_ns_max.load(std::memory_order_relaxed) / 1e6 << " ms | " << missed.load(std::memory_order_relaxed) << " missed "
+            << skipped.load(std::memory_order_relaxed) << " skipped\n";
+    }
+};
+
+/**
+ * What a frame_scheduler does when the work of a frame ran past its deadline.
+ */
+enum class overrun_policy
+{
+    /** start the late frames back to back until the grid is reached again (at most k_max_catch_up) */
+    catch_up,
+    /** drop the missed slots and wait for the next deadline still ahead */
+    skip
+};
+
+/**
+ * Paces a frame loop on a grid of absolute deadlines, so the period does not stretch by the time
+ * the work takes and errors do not accumulate. Call wait() once per frame after the work is done.
+ */
+class frame_scheduler
+{
+    using clock = std::chrono::steady_clock;
+
+    clock::duration period_;
+    overrun_policy policy_;
+    clock::time_point deadline_{};
+    clock::time_point last_{};
+    frame_stats stats_;
+
+  public:
+    static constexpr int64_t k_max_catch_up = 4;
+
+    explicit frame_scheduler(clock::duration period, overrun_policy policy = overrun_policy::skip) : period_(std::max(period, clock::duration(1))), policy_(policy)
+    {
+    }
+
+    void set_period(clock::duration period)
+    {
+        period_ = std::max(period, clock::duration(1));
+        restart();
+    }
+
+    clock::duration period() const
+    {
+        return period_;
+    }
+
+    void set_policy(overrun_policy policy)
+    {
+        policy_ = policy;
+    }
+
+    overrun_policy policy() const
+    {
+        return policy_;
+    }
+
+    /** Starts a new deadline grid at the next wait(), e.g. after the loop was paused. */
+    void restart()
+    {
+        deadline_ = {};
+    }
+
+    /**
+     * Sleeps until the next deadline. Returns how many frame periods the loop advanced: 1 on time,
+     * more when slots were skipped, so time-based animations can keep their phase.
+     */
+    size_t wait()
+    {
+        auto now = clock::now();
+        bool first = deadline_ == clock::time_point{};
+        if (first) deadline_ = now;
+
+        deadline_ += period_;
+        size_t advanced = 1;
+
+        if (now > deadline_) {
+            stats_.missed.fetch_add(1, std::memory_order_relaxed);
+            int64_t behind = (now - deadline_) / period_;
+            if (policy_ == overrun_policy::skip || behind >= k_max_catch_up) {
+                int64_t skip = policy_ == overrun_policy::skip ? behind + 1 : behind;
+                deadline_ += skip * period_;
+                advanced += skip;
+                stats_.skipped.fetch_add(skip, std::memory_order_relaxed);
+            }
+        }
+
+        std::this_thread::sleep_until(deadline_);
+
+        auto woke = clock::now();
+        if (!first) stats_.record(woke - last_, woke - deadline_);
+        last_ = woke;
+        return advanced;
+    }
+
+    const frame_stats& stats() const
+    {
+        return stats_;
+    }
+};
+
+} // namespace led
@@ -1,29 +1,92 @@
 #pragma once
 #include "color.hpp"
+#include "hid_transport.hpp"
+#include "report_encoder.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
 #include <vector>
 
-struct hid_device_;
-typedef struct hid_device_ hid_device;
-
 namespace led
 {
 
 constexpr uint16_t k_vendor_id = 0x37FA;
 constexpr uint16_t k_product_id = 0x8202;
-constexpr size_t k_buffer_size = 65;
 constexpr size_t k_read_size = 64;
+constexpr std::chrono::milliseconds k_command_timeout{ 250 };
+
+/**
+ * A command report and where to put its response (may be nullptr).
+ */
+struct hid_command
+{
+    uint8_t cmd;
+    const uint8_t* data;
+    size_t data_len;
+    uint8_t* response;
+};
+
+/**
+ * Frame counters of the asynchronous color writer.
+ */
+struct hid_writer_stats
+{
+    /** frames written to the device */
+    std::atomic<uint64_t> sent{ 0 };
+    /** time spent packing and writing the sent frames, on the writer thread */
+    std::atomic<uint64_t> busy_ns{ 0 };
+    /** frames replaced in the mailbox by a newer one before they were written */
+    std::atomic<uint64_t> dropped{ 0 };
+    /** frames skipped because no LED changed by at least the change threshold */
+    std::atomic<uint64_t> suppressed{ 0 };
+};
 
 class hid_device_wrapper
 {
-    hid_device* device_;
+    std::unique_ptr<hid_transport> transport_;
     size_t zone_count_;
+    device_descriptor descriptor_;
+
+    /** serializes every hid_write/hid_read between the writer thread and commands */
+    std::mutex io_mutex_;
+
+    std::mutex mailbox_mutex_;
+    std::condition_variable mailbox_cv_;
+    std::vector<color> mailbox_;
+    bool mailbox_full_ = false;
+    bool stop_ = false;
+
+    std::vector<color> last_sent_;
+    /** the strip's wire format and the reports of the frame being written, used by the writer thread */
+    report_encoder reports_;
+    std::atomic<uint8_t> change_threshold_{ 1 };
+    hid_writer_stats stats_;
+    std::thread writer_;
 
     size_t query_zone_count();
-    void write_rgb_data(const std::vector<uint8_t>& rgb_data);
+    bool load_cached();
+    void store_cached() const;
+    void write_colors(const std::vector<color>& colors);
+    bool changed_enough(const std::vector<color>& colors) const;
+    void writer_loop();
 
   public:
-    explicit hid_device_wrapper(uint16_t vid = k_vendor_id, uint16_t pid = k_product_id);
+    /**
+     * With `use_cache`, the zone count is read from the per-serial cache instead of being queried.
+     * `format` is the strip's channel order and report split, see strip_format.
+     */
+    explicit hid_device_wrapper(uint16_t vid = k_vendor_id, uint16_t pid = k_product_id, bool use_cache = true, strip_format format = screen_mirror_format());
+
+    /** Drives the strip through any transport, e.g. a loopback_device emulating the same `format`. */
+    explicit hid_device_wrapper(std::unique_ptr<hid_transport> transport, bool use_cache = false, strip_format format = screen_mirror_format());
     ~hid_device_wrapper();
 
     hid_device_wrapper(const hid_device_wrapper&) = delete;
@@ -34,9 +97,45 @@ class hid_device_wrapper
         return zone_count_;
     }
 
-    void send_command(uint8_t cmd, const uint8_t* data, size_t data_len, uint8_t* response = nullptr);
-    void set_colors(const std::vector<color>& colors);
-    void initialize();
+    const device_descriptor& descriptor() const
+    {
+        return descriptor_;
+    }
+
+    /** The wire format given at construction; it never changes, so any thread may read it. */
+    const strip_format& format() const
+    {
+        return reports_.format();
+    }
+
+    hid_transport& transport()
+    {
+        return *transport_;
+    }
+
+    bool send_command(uint8_t cmd, const uint8_t* data, size_t data_len, uint8_t* response = nullptr);
+    bool send_commands(const hid_command* commands, size_t count, std::chrono::milliseconds timeout = k_command_timeout);
+
+    /**
+     * Hands the frame to the writer thread and returns immediately. A frame still waiting in the
+     * one-slot mailbox is replaced, so a slow USB link never builds up latency. The mailbox keeps
+     * its storage, so frames of a constant size do not allocate.
+     */
+    void set_colors(std::span<const color> colors);
+
+    /** Minimum change of any channel of any LED, relative to the last frame sent, for a frame to be written. */
+    void set_change_threshold(uint8_t threshold)
+    {
+        change_threshold_ = threshold;
+    }
+
+    const hid_writer_stats& writer_stats() const
+    {
+        return stats_;
+    }
+
+    /** Powers the strip on at full brightness; false if the strip did not confirm both. */
+    bool initialize();
 };
 
 } // namespace led
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace led
+{
+
+struct device_descriptor
+{
+    std::string serial;
+    std::string manufacturer;
+    std::string product;
+    uint16_t release = 0;
+};
+
+/**
+ * Raw report I/O underneath hid_device_wrapper. Reports are framed as for hidapi: a leading
+ * report ID byte on writes, none on reads. Calls are serialized by the caller.
+ */
+class hid_transport
+{
+  public:
+    virtual ~hid_transport() = default;
+
+    /** Returns the number of bytes written or -1 on error. */
+    virtual int write(const uint8_t* data, size_t length) = 0;
+
+    /** Waits up to `milliseconds` for an input report; returns its length, 0 on timeout or -1 on error. */
+    virtual int read_timeout(uint8_t* data, size_t length, int milliseconds) = 0;
+
+    virtual const device_descriptor& descriptor() const = 0;
+};
+
+/**
+ * Opens the first hidapi device matching `vid`/`pid`. Throws std::runtime_error if there is none.
+ */
+std::unique_ptr<hid_transport> open_hidapi_transport(uint16_t vid, uint16_t pid);
+
+/**
+ * Opens every hidapi device matching `vid`/`pid`, ordered by serial number so that the same
+ * strip keeps the same position across runs. Devices that fail to open are skipped; the result
+ * is empty if none could be opened.
+ */
+std::vector<std::unique_ptr<hid_transport>> open_hidapi_transports(uint16_t vid, uint16_t pid);
+
+} // namespace led
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * Memory layout of a captured pixel, named by byte order in memory as video tools (ffmpeg
+ * -pix_fmt) name them; rgb565 is the exception, a 16-bit value named from its most significant bit.
+ */
+enum class PixelFormat
+{
+    /** 4 bytes B, G, R, A */
+    bgra32,
+    /** 4 bytes B, G, R and an unused byte, the usual 24-bit depth visual */
+    bgrx32,
+    /** 3 bytes B, G, R, a 24-bit visual packed without padding */
+    bgr24,
+    /** 16-bit little-endian pixels, 5 bits red, 6 green, 5 blue */
+    rgb565,
+    /** 4 bytes R, G, B, A */
+    rgba32,
+    /** 3 bytes R, G, B */
+    rgb24
+};
+
+constexpr int bytes_per_pixel(PixelFormat format)
+{
+    switch (format) {
+        case PixelFormat::bgr24:
+        case PixelFormat::rgb24: return 3;
+        case PixelFormat::rgb565: return 2;
+        default: return 4;
+    }
+}
+
+struct ImageRect
+{
+    int x, y, width, height;
+};
+
+/**
+ * A block of pixels with `stride` bytes between the starts of consecutive rows.
+ */
+struct ImageStrip
+{
+    const uint8_t* data = nullptr;
+    int stride = 0;
+};
+
+/**
+ * A whole captured frame; rows are `stride` bytes apart, which may be more than `width` pixels.
+ */
+struct ImageView
+{
+    const uint8_t* data = nullptr;
+    int width = 0, height = 0, stride = 0;
+    PixelFormat format = PixelFormat::bgra32;
+};
+
+/**
+ * A frame of which only the four edges were captured. `top` and `bottom` are
+ * width x depth, `left` and `right` are depth x (height - 2 * depth) and cover
+ * the rows between them.
+ */
+struct BorderStrips
+{
+    int width = 0, height = 0, depth = 0;
+    PixelFormat format = PixelFormat::bgra32;
+    ImageStrip top, bottom, left, right;
+};
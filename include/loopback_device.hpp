@@ -0,0 +1,77 @@
+#pragma once
+#include "color.hpp"
+#include "hid_transport.hpp"
+#include "report_encoder.hpp"
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace led
+{
+
+/**
+ * In-memory emulation of the LED strip: answers the 0x03 zone count query, acknowledges the
+ * 0x07 power and 0x09 brightness commands and decodes 0x02 color frames, so that everything
+ * above hid_device_wrapper can run and be measured without USB hardware.
+ */
+class loopback_device : public hid_transport
+{
+    static constexpr size_t k_report_size = 64;
+
+    mutable std::mutex mutex_;
+    std::condition_variable response_cv_;
+    std::deque<std::array<uint8_t, k_report_size>> responses_;
+
+    device_descriptor descriptor_;
+    size_t zone_count_;
+    std::chrono::microseconds write_latency_;
+    strip_format format_;
+
+    /** continuation reports of the 0x02 frame being received */
+    size_t packets_left_ = 0;
+    size_t expected_ = 0;
+    std::vector<uint8_t> rgb_;
+    std::vector<color> frame_;
+
+    uint64_t frames_ = 0;
+    uint64_t reports_ = 0;
+    bool powered_ = false;
+    uint8_t brightness_ = 0;
+
+    void respond(uint8_t cmd, uint8_t value);
+    void decode_frame();
+
+  public:
+    /**
+     * `write_latency` is slept on every report to mimic the USB interrupt transfer. The zone
+     * count query answers with one byte, so at most 255 zones can be emulated.
+     */
+    explicit loopback_device(size_t zone_count = 40, std::chrono::microseconds write_latency = std::chrono::microseconds(0),
+                             strip_format format = screen_mirror_format());
+
+    int write(const uint8_t* data, size_t length) override;
+    int read_timeout(uint8_t* data, size_t length, int milliseconds) override;
+
+    const device_descriptor& descriptor() const override
+    {
+        return descriptor_;
+    }
+
+    /** Complete color frames decoded so far. */
+    uint64_t frames() const;
+
+    /** Reports written so far, including the three per color frame. */
+    uint64_t reports() const;
+
+    /** The most recent decoded frame in zone order, swizzling undone. */
+    std::vector<color> last_frame() const;
+
+    bool powered() const;
+    uint8_t brightness() const;
+};
+
+} // namespace led
@@ -0,0 +1,139 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+namespace led
+{
+
+/**
+ * Lock-free latency histogram with log-linear buckets: exact below 16 ns, then eight buckets per
+ * power of two (at most 12.5% wide) up to about 18 minutes. record() is two relaxed atomic adds
+ * plus a bit scan, so it can sit on the hot path of any thread.
+ */
+class latency_histogram
+{
+  public:
+    static constexpr size_t k_linear = 16;
+    static constexpr size_t k_sub_bits = 3;
+    static constexpr size_t k_max_exponent = 40;
+    static constexpr size_t k_buckets = k_linear + (k_max_exponent - 4 + 1) * (size_t(1) << k_sub_bits);
+
+  private:
+    std::array<std::atomic<uint64_t>, k_buckets> buckets_{};
+    std::atomic<uint64_t> count_{ 0 };
+    std::atomic<uint64_t> sum_ns_{ 0 };
+
+    static size_t bucket_of(uint64_t ns);
+    static uint64_t bucket_upper(size_t bucket);
+
+  public:
+    void record(std::chrono::steady_clock::duration elapsed)
+    {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        uint64_t value = ns > 0 ? static_cast<uint64_t>(ns) : 0;
+        buckets_[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_ns_.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const
+    {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t sum_ns() const
+    {
+        return sum_ns_.load(std::memory_order_relaxed);
+    }
+
+    /** Upper edge of the bucket holding the p-th fraction (0..1) of samples, in nanoseconds. */
+    uint64_t percentile_ns(double p) const;
+};
+
+/**
+ * Times a scope into a histogram.
+ */
+class scoped_timer
+{
+    latency_histogram& histogram_;
+    std::chrono::steady_clock::time_point start_;
+
+  public:
+    explicit scoped_timer(latency_histogram& histogram) : histogram_(histogram), start_(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~scoped_timer()
+    {
+        histogram_.record(std::chrono::steady_clock::now() - start_);
+    }
+
+    scoped_timer(const scoped_timer&) = delete;
+    scoped_timer& operator=(const scoped_timer&) = delete;
+};
+
+/** Returns `f()`, timed into `histogram`. */
+template <typename F>
+auto timed(latency_histogram& histogram, F&& f)
+{
+    scoped_timer timer(histogram);
+    return f();
+}
+
+/**
+ * Process-wide latency of each reactive-mode stage.
+ */
+struct hot_path_metrics
+{
+    /** ScreenCapture::capture / capture_border */
+    latency_histogram capture;
+    /** ZoneAnalyzer::analyze */
+    latency_histogram analyze;
+    /** color_encoder::encode of one frame */
+    latency_histogram encode;
+    /** encoding a frame into output reports in the HID writer */
+    latency_histogram pack;
+    /** each individual report written to the transport */
+    latency_histogram hid_write;
+    /** frames handed to hid_device_wrapper::set_colors */
+    std::atomic<uint64_t> frames{ 0 };
+};
+
+hot_path_metrics& hot_path();
+
+/** Writes all hot path metrics in the Prometheus text exposition format. */
+void write_prometheus(std::ostream& out, const hot_path_metrics& metrics);
+
+/**
+ * Rewrites a Prometheus text file every `interval` from a background thread, e.g. for the
+ * node_exporter textfile collector. The file is replaced atomically, so readers never see a
+ * partial export.
+ */
+class metrics_exporter
+{
+    std::string path_;
+    std::chrono::milliseconds interval_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    std::thread thread_;
+
+    void export_once() const;
+
+  public:
+    metrics_exporter(std::string path, std::chrono::milliseconds interval);
+    ~metrics_exporter();
+
+    metrics_exporter(const metrics_exporter&) = delete;
+    metrics_exporter& operator=(const metrics_exporter&) = delete;
+};
+
+} // namespace led
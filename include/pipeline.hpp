@@ -0,0 +1,151 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace led
+{
+
+/**
+ * Bounded lock-free queue between exactly one producer and one consumer thread.
+ * Slots are filled and drained in place, so a slot's index stays stable while either side
+ * works on it; that lets a producer tie external buffers (e.g. SHM images) to a slot.
+ */
+template <typename T, size_t N>
+class spsc_ring
+{
+    std::array<T, N> slots_{};
+    alignas(64) std::atomic<uint32_t> head_{ 0 };
+    alignas(64) std::atomic<uint32_t> tail_{ 0 };
+
+  public:
+    static constexpr size_t capacity = N;
+
+    /** Slot the producer may fill next, or nullptr while the queue is full. */
+    T* write_slot()
+    {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == N) return nullptr;
+        return &slots_[tail % N];
+    }
+
+    size_t write_index() const
+    {
+        return tail_.load(std::memory_order_relaxed) % N;
+    }
+
+    void push()
+    {
+        tail_.fetch_add(1, std::memory_order_release);
+        tail_.notify_one();
+    }
+
+    /** Oldest filled slot, or nullptr while the queue is empty. */
+    T* read_slot()
+    {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        if (tail_.load(std::memory_order_acquire) == head) return nullptr;
+        return &slots_[head % N];
+    }
+
+    void pop()
+    {
+        head_.fetch_add(1, std::memory_order_release);
+        head_.notify_one();
+    }
+
+    /** Blocks the consumer until something was pushed since `read_slot()` returned nullptr. */
+    void wait_readable() const
+    {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        tail_.wait(head, std::memory_order_acquire);
+    }
+
+    /** Blocks the producer until the consumer frees a slot. */
+    void wait_writable() const
+    {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        head_.wait(tail - static_cast<uint32_t>(N), std::memory_order_acquire);
+    }
+
+    size_t depth() const
+    {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+};
+
+/**
+ * Lock-free latest-value hand-off: the producer always has a private buffer to write,
+ * the consumer always reads the most recently published one, stale values are overwritten.
+ */
+template <typename T>
+class triple_buffer
+{
+    static constexpr uint8_t k_fresh = 0x4;
+    static constexpr uint8_t k_index = 0x3;
+
+    std::array<T, 3> buffers_{};
+    alignas(64) std::atomic<uint8_t> middle_{ 1 };
+    uint8_t back_ = 0;
+    uint8_t front_ = 2;
+
+  public:
+    T& back()
+    {
+        return buffers_[back_];
+    }
+
+    /** Publishes back(); returns false if the previous value was never consumed. */
+    bool publish()
+    {
+        uint8_t prev = middle_.exchange(back_ | k_fresh, std::memory_order_acq_rel);
+        back_ = prev & k_index;
+        middle_.notify_one();
+        return !(prev & k_fresh);
+    }
+
+    /** Swaps in the latest published value if there is one, see front(). */
+    bool acquire()
+    {
+        if (!(middle_.load(std::memory_order_relaxed) & k_fresh)) return false;
+        uint8_t prev = middle_.exchange(front_, std::memory_order_acq_rel);
+        front_ = prev & k_index;
+        return true;
+    }
+
+    const T& front() const
+    {
+        return buffers_[front_];
+    }
+
+    /** Blocks the consumer until a value newer than front() is published. */
+    void wait() const
+    {
+        uint8_t middle = middle_.load(std::memory_order_acquire);
+        if (middle & k_fresh) return;
+        middle_.wait(middle, std::memory_order_acquire);
+    }
+};
+
+/**
+ * Throughput counters of one pipeline stage, written by that stage only.
+ */
+struct stage_stats
+{
+    std::atomic<uint64_t> frames{ 0 };
+    std::atomic<uint64_t> busy_ns{ 0 };
+    /** times the stage had to wait on its neighbour */
+    std::atomic<uint64_t> stalls{ 0 };
+    /** results overwritten before the next stage picked them up */
+    std::atomic<uint64_t> dropped{ 0 };
+
+    void record(std::chrono::steady_clock::duration busy)
+    {
+        frames.fetch_add(1, std::memory_order_relaxed);
+        busy_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(busy).count(), std::memory_order_relaxed);
+    }
+};
+
+} // namespace led
@@ -0,0 +1,145 @@
+#pragma once
+#include "image.hpp"
+#include "pipeline.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Start of a raw video file: 32 bytes, little-endian, followed by the frames back to back, each
+ * `height` rows of `stride` bytes.
+ */
+struct RawVideoHeader
+{
+    char magic[4] = { 'N', 'L', 'R', 'V' };
+    uint32_t version = 1;
+    uint32_t width = 0, height = 0;
+    /** bytes per row, 0 for width * bytes per pixel */
+    uint32_t stride = 0;
+    /** a PixelFormat value: 0 BGRA, 1 BGRX, 2 B,G,R, 3 RGB565, 4 RGBA, 5 R,G,B */
+    uint32_t format = 0;
+    /** playback rate fps_num / fps_den; 0 advances one frame per capture, for reproducible runs */
+    uint32_t fps_num = 0, fps_den = 1;
+};
+
+static_assert(sizeof(RawVideoHeader) == 32, "RawVideoHeader is a file format");
+
+/**
+ * Parses the pixel format names of video tools (ffmpeg -pix_fmt): bgra, bgr0, rgba, rgb24,
+ * bgr24 and rgb565le. Returns false for anything else.
+ */
+bool parse_raw_format(const std::string& name, PixelFormat& format);
+
+/**
+ * Frames from a raw video file or stream instead of the screen, for reproducible runs and video
+ * pipelines. `spec` is
+ *
+ *   path                                 a file starting with a RawVideoHeader
+ *   path:WIDTHxHEIGHT:FORMAT[:FPS]       headerless frames, e.g. clip.raw:1920x1080:bgra:30
+ *
+ * where path "-" reads stdin, e.g. the output of ffmpeg -f rawvideo -pix_fmt bgra -. Files, and
+ * stdin redirected from one, are memory-mapped and captured without copying: image() and the
+ * border strips point into the mapping, and files loop at their end. A pipe is read on a thread
+ * of its own; capture always takes the newest complete frame, and border strips are copied out
+ * so the reader can go on while they are analyzed. The last frame stays after the stream ends.
+ *
+ * Throws std::runtime_error when the source cannot be opened or is malformed.
+ */
+class RawFrameSource
+{
+  public:
+    /** Strip sets capture_border() can fill, as many as ScreenCapture has. */
+    static constexpr int k_border_buffers = 3;
+
+  private:
+    using clock = std::chrono::steady_clock;
+
+    /** Border strips copied out of a stream frame. */
+    struct StripCopy
+    {
+        std::vector<uint8_t> top, bottom, left, right;
+    };
+
+    int width_ = 0, height_ = 0, stride_ = 0;
+    PixelFormat format_ = PixelFormat::bgra32;
+    size_t frame_bytes_ = 0;
+    uint32_t fps_num_ = 0, fps_den_ = 1;
+
+    /** a mapped file: the frames and how many of them there are */
+    const uint8_t* frames_ = nullptr;
+    void* map_ = nullptr;
+    size_t map_bytes_ = 0;
+    size_t frame_count_ = 0;
+    size_t next_step_ = 0;
+    clock::time_point start_{};
+    bool started_ = false;
+
+    /** a stream: frames read by reader_ into the back buffer, counted as they are taken */
+    int fd_ = -1;
+    bool owns_fd_ = false;
+    led::triple_buffer<std::vector<uint8_t>> stream_;
+    std::thread reader_;
+    std::atomic<bool> stop_{ false };
+    uint64_t received_ = 0;
+    StripCopy copies_[k_border_buffers];
+
+    /** the frame of the last capture: its file index or stream count */
+    const uint8_t* current_ = nullptr;
+    uint64_t shown_ = UINT64_MAX;
+
+    int capture_x_ = 0, capture_y_ = 0, capture_width_ = 0, capture_height_ = 0;
+    BorderStrips border_[k_border_buffers];
+
+    void map_file(int fd, uint64_t offset);
+    void read_stream();
+    uint64_t frame_due(clock::time_point now) const;
+    bool take_frame(float percent);
+
+  public:
+    explicit RawFrameSource(const std::string& spec);
+    ~RawFrameSource();
+
+    RawFrameSource(const RawFrameSource&) = delete;
+    RawFrameSource& operator=(const RawFrameSource&) = delete;
+
+    /** Takes the frame that is due and crops it to the centered `percent` rectangle, see image(). */
+    bool capture(float percent);
+
+    /** Like capture(), but also fills strip set `buffer` with the `depth`-pixel edges of the crop. */
+    bool capture_border(float percent, int depth, int buffer);
+
+    const BorderStrips& border(int buffer) const
+    {
+        return border_[buffer];
+    }
+
+    /** Empty damage and true while the frame that is due has already been captured, false when there is a new one. */
+    bool poll_damage(std::vector<ImageRect>& damage);
+
+    ImageView image() const;
+
+    int width() const
+    {
+        return capture_width_;
+    }
+
+    int height() const
+    {
+        return capture_height_;
+    }
+
+    PixelFormat format() const
+    {
+        return format_;
+    }
+
+    /** Frames per second the source is played at, 0 for one frame per capture or a stream. */
+    double frame_rate() const
+    {
+        return fps_num_ ? static_cast<double>(fps_num_) / fps_den_ : 0.0;
+    }
+};
@@ -0,0 +1,102 @@
+#pragma once
+#include "color.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace led
+{
+
+/** Output report size including the leading report ID byte. */
+constexpr size_t k_buffer_size = 65;
+
+/** Offset of the red, green and blue byte within one LED's three bytes on the wire. */
+struct channel_order
+{
+    uint8_t r, g, b;
+};
+
+constexpr channel_order k_order_grb{ 1, 0, 2 };
+constexpr channel_order k_order_rbg{ 0, 2, 1 };
+
+/** LEDs from `first_zone` up to the next run use `order`. */
+struct channel_order_run
+{
+    size_t first_zone;
+    channel_order order;
+};
+
+/**
+ * How a strip expects a 0x02 color frame: the channel order of every LED and how the color
+ * bytes are split across output reports.
+ */
+struct strip_format
+{
+    /** sorted by first_zone, starting at zone 0 */
+    std::vector<channel_order_run> orders;
+    /** color bytes after the command header of the first report, and in every following one */
+    size_t first_payload = 60;
+    size_t next_payload = 64;
+    /** reports sent even when the colors fit into fewer */
+    size_t min_reports = 1;
+};
+
+/**
+ * The PC Screen Mirror LS: zones 0-19 GRB, 20+ RBG. Frames always span at least three reports,
+ * which is all the stock 54-LED strip has ever been sent.
+ */
+strip_format screen_mirror_format();
+
+/**
+ * Encodes color frames straight into ready-to-send output reports. The map from every wire
+ * byte to its source channel is computed once per LED count, so encoding is one table-driven
+ * copy with no per-LED branch and no intermediate buffer; frames of a constant size do not
+ * allocate. Any LED count the two-byte length field can describe gets as many reports as it needs.
+ */
+class report_encoder
+{
+    /** wire byte `to` (into reports_) takes byte `from` of the color array */
+    struct byte_move
+    {
+        uint32_t to, from;
+    };
+
+    strip_format format_;
+    size_t zones_ = 0;
+    size_t report_count_ = 0;
+    std::vector<uint8_t> reports_;
+    std::vector<byte_move> moves_;
+
+    void build(size_t zones);
+
+  public:
+    explicit report_encoder(strip_format format = screen_mirror_format());
+
+    /** Fills the reports with `colors`; call report()/report_count() for the result. */
+    void encode(std::span<const color> colors);
+
+    size_t report_count() const
+    {
+        return report_count_;
+    }
+
+    /** The `index`-th report of the last frame, k_buffer_size bytes, report ID byte included. */
+    const uint8_t* report(size_t index) const
+    {
+        return reports_.data() + index * k_buffer_size;
+    }
+
+    const strip_format& format() const
+    {
+        return format_;
+    }
+
+    /** Reports a frame of `bytes` color bytes needs. */
+    static size_t reports_for(const strip_format& format, size_t bytes);
+
+    /** Where LED `zone`'s channels go on the wire. */
+    static channel_order order_of(const strip_format& format, size_t zone);
+};
+
+} // namespace led
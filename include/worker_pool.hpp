@@ -0,0 +1,50 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+/**
+ * Persistent threads for data-parallel loops. run() hands the index range [0, count) to the
+ * workers and the calling thread, which take indices one at a time, and returns once all of them
+ * are done. Dispatch neither allocates nor locks: workers sleep on an atomic generation counter.
+ * Only one thread may call run() at a time.
+ */
+class WorkerPool
+{
+    using TaskFn = void (*)(void* context, size_t index);
+
+    std::vector<std::thread> threads_;
+
+    TaskFn task_ = nullptr;
+    void* context_ = nullptr;
+    size_t count_ = 0;
+    std::atomic<size_t> next_{ 0 };
+    alignas(64) std::atomic<uint32_t> generation_{ 0 };
+    alignas(64) std::atomic<uint32_t> pending_{ 0 };
+    bool stop_ = false;
+
+    void worker_loop();
+    void dispatch(size_t count, TaskFn task, void* context);
+
+  public:
+    /** `workers` counts the calling thread, so 1 starts no threads and runs everything inline. */
+    explicit WorkerPool(size_t workers);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    size_t size() const
+    {
+        return threads_.size() + 1;
+    }
+
+    /** Calls `task(i)` once for every i in [0, count), spread over the pool. */
+    template <typename Task>
+    void run(size_t count, Task& task)
+    {
+        dispatch(count, [](void* context, size_t index) { (*static_cast<Task*>(context))(index); }, &task);
+    }
+};
@@ -1,26 +1,203 @@
 #pragma once
+#include "image.hpp"
+#include "zone_kernels.hpp"
+#include <cstddef>
 #include <cstdint>
+#include <span>
 #include <vector>
 
+class WorkerPool;
+
+/**
+ * Average color of a zone in 8.8 fixed point (255 == 0xFF00), see led::color16.
+ */
 struct ZoneColor
 {
-    float r, g, b;
+    uint16_t r, g, b;
+};
+
+struct ZoneRect
+{
+    int x, y, width, height;
 };
 
 class ZoneAnalyzer
 {
   public:
-    ZoneAnalyzer(int zone_depth = 50);
+    ZoneAnalyzer(int zone_depth = 50, int sample_stride = 1);
 
+    /**
+     * Averages every border zone in a single row-major pass over the image.
+     * Zones are ordered bottom (right to left), left (bottom to top), top (left to right), right (top to bottom).
+     */
+    std::vector<ZoneColor> analyze(const ImageView& image, int bottom_zones, int left_zones, int top_zones, int right_zones);
+
+    /** Same as above for tightly packed rows; `bpp` 4 is read as BGRX, 3 as BGR and 2 as rgb565. */
     std::vector<ZoneColor> analyze(uint8_t* img_data, int width, int height, int bpp, int bottom_zones, int left_zones, int top_zones, int right_zones);
 
+    /** Same as above, reading straight from border-only captured strips. */
+    std::vector<ZoneColor> analyze(const BorderStrips& strips, int bottom_zones, int left_zones, int top_zones, int right_zones);
+
+    /**
+     * Incremental variant: only zones whose sampling rectangle intersects one of the `damage`
+     * areas (frame coordinates) are re-read, the others keep their colors from the previous call.
+     * Falls back to a full pass whenever the layout changed.
+     */
+    std::vector<ZoneColor> analyze(const BorderStrips& strips, int bottom_zones, int left_zones, int top_zones, int right_zones, const std::vector<ImageRect>& damage);
+
+    /**
+     * Allocation-free variants of the above: the colors are written into the caller's `out`
+     * (sized with zone_count()) and the number of zones written is returned. Once the layout
+     * for a geometry has been built, repeated calls do not touch the heap.
+     */
+    size_t analyze(const ImageView& image, int bottom_zones, int left_zones, int top_zones, int right_zones, std::span<ZoneColor> out);
+    size_t analyze(uint8_t* img_data, int width, int height, int bpp, int bottom_zones, int left_zones, int top_zones, int right_zones, std::span<ZoneColor> out);
+    size_t analyze(const BorderStrips& strips, int bottom_zones, int left_zones, int top_zones, int right_zones, std::span<ZoneColor> out);
+    size_t analyze(const BorderStrips& strips, int bottom_zones, int left_zones, int top_zones, int right_zones, std::span<const ImageRect> damage, std::span<ZoneColor> out);
+
+    /** Number of colors analyze() produces for a zone configuration; corners are shared by two edges. */
+    static size_t zone_count(int bottom_zones, int left_zones, int top_zones, int right_zones)
+    {
+        int total = bottom_zones + left_zones - 1 + top_zones - 2 + right_zones - 1;
+        return total > 0 ? static_cast<size_t>(total) : 0;
+    }
+
+    /** Number of zones actually re-read by the last analyze() call. */
+    size_t last_recomputed() const
+    {
+        return recomputed_;
+    }
+
     void set_zone_depth(int depth)
     {
         zone_depth_ = depth;
     }
 
+    /**
+     * Samples only every `stride`-th row and column of each zone, counted from the zone's
+     * top-left corner. A stride of 1 reads every pixel; n reads roughly 1/n^2 of them.
+     */
+    void set_sample_stride(int stride)
+    {
+        sample_stride_ = stride < 1 ? 1 : stride;
+    }
+
+    int sample_stride() const
+    {
+        return sample_stride_;
+    }
+
+    /** Overrides the runtime-selected kernel for 32-bit pixels, e.g. to compare against the scalar path. */
+    void set_kernel(RowSumKernel kernel)
+    {
+        kernel_ = kernel;
+    }
+
+    RowSumKernel kernel() const
+    {
+        return kernel_;
+    }
+
+    /**
+     * Spreads the pixel work of large frames over `pool` (not owned, may be shared between
+     * analyzers that are used from the same thread). Zones are cut into row tiles of similar
+     * sampled pixel count, so long top and bottom zones do not leave workers idle. nullptr or a
+     * single-worker pool keeps the serial row-major pass.
+     */
+    void set_worker_pool(WorkerPool* pool)
+    {
+        pool_ = pool;
+        tile_workers_ = 0;
+    }
+
+    /** Tiles the last parallel analyze() call was split into, 0 if it ran serially. */
+    size_t last_tile_count() const
+    {
+        return last_tiles_;
+    }
+
+    /** Sampling rectangles from the last analyze() call, in output order. */
+    const std::vector<ZoneRect>& zone_rects() const
+    {
+        return rects_;
+    }
+
   private:
+    /** A horizontal run of pixels inside one row that belongs to a zone. */
+    struct Span
+    {
+        int x, width, zone;
+        int zone_y;
+    };
+
+    /** Consecutive rows that share the same set of spans, sorted by x. */
+    struct Band
+    {
+        int y_begin, y_end;
+        size_t first_span, span_count;
+    };
+
+    /** Rows [y_begin, y_end) of a zone's x range, summed by one worker into its own slot. */
+    struct Tile
+    {
+        int zone;
+        int x, width, y_begin, y_end;
+    };
+
+    /** below this many sampled pixels waking the workers costs more than it saves */
+    static constexpr size_t k_min_parallel_pixels = 65536;
+    /** tiles are not cut smaller than this, so a tile always outweighs its dispatch */
+    static constexpr size_t k_min_tile_pixels = 4096;
+
+    struct Layout
+    {
+        int width = 0, height = 0, depth = 0, stride = 0;
+        int bottom = 0, left = 0, top = 0, right = 0;
+    };
+
     int zone_depth_;
+    int sample_stride_;
+    RowSumKernel kernel_;
+
+    Layout layout_;
+    std::vector<ZoneRect> rects_;
+    std::vector<Span> spans_;
+    std::vector<Band> bands_;
+    std::vector<ChannelSums> sums_;
+    std::vector<uint8_t> dirty_;
+    std::vector<ZoneColor> colors_;
+    bool partial_ = false;
+    size_t recomputed_ = 0;
+    /** sampled pixels of the zones to recompute */
+    size_t work_pixels_ = 0;
+
+    WorkerPool* pool_ = nullptr;
+    std::vector<Tile> tiles_;
+    std::vector<ChannelSums> tile_sums_;
+    /** pool size tiles_ was cut for, 0 if it has to be rebuilt */
+    size_t tile_workers_ = 0;
+    size_t last_tiles_ = 0;
+
+    void build_layout(int width, int height, int depth, int bottom_zones, int left_zones, int top_zones, int right_zones);
+    void prepare(int width, int height, int depth, int bottom_zones, int left_zones, int top_zones, int right_zones, const std::span<const ImageRect>* damage);
+
+    void build_tiles(size_t workers);
+
+    /** Inner loops are instantiated per pixel format, so choosing one costs a single switch per frame. */
+    template <PixelFormat F>
+    void sum_pixels(const uint8_t* row, int pixels, int stride, ChannelSums& sums) const;
+
+    template <PixelFormat F, typename PixelAt>
+    void accumulate(PixelAt pixel_at);
+
+    template <PixelFormat F, typename PixelAt>
+    void accumulate_tiles(PixelAt pixel_at);
+
+    const std::vector<ZoneColor>& resolve();
+
+    const std::vector<ZoneColor>& analyze_image(const ImageView& image, int bottom_zones, int left_zones, int top_zones, int right_zones);
+    const std::vector<ZoneColor>& analyze_strips(const BorderStrips& strips, int bottom_zones, int left_zones, int top_zones, int right_zones,
+                                                 const std::span<const ImageRect>* damage);
 
-    ZoneColor average_region(uint8_t* data, int img_width, int bpp, int x_start, int y_start, int region_width, int region_height);
+    static size_t copy_out(const std::vector<ZoneColor>& colors, std::span<ZoneColor> out);
 };
@@ -0,0 +1,73 @@
+#pragma once
+#include "image.hpp"
+#include <cstdint>
+
+/**
+ * Per-channel running totals for a run of pixels.
+ */
+struct ChannelSums
+{
+    uint64_t r, g, b;
+};
+
+/**
+ * Adds `pixels` consecutive BGRA (or BGRX) pixels starting at `row` into `sums`.
+ * Every implementation must produce exactly the same totals as the scalar one.
+ */
+using RowSumKernel = void (*)(const uint8_t* row, int pixels, ChannelSums& sums);
+
+void sum_bgra_scalar(const uint8_t* row, int pixels, ChannelSums& sums);
+void sum_bgra_sse2(const uint8_t* row, int pixels, ChannelSums& sums);
+void sum_bgra_avx2(const uint8_t* row, int pixels, ChannelSums& sums);
+
+/**
+ * Size and channel extraction of one pixel format. Channels are summed as 8-bit values, so the
+ * 5 and 6-bit fields of rgb565 are widened by repeating their top bits (0x1F -> 0xFF).
+ */
+template <PixelFormat F>
+struct PixelTraits
+{
+    static constexpr int bytes = bytes_per_pixel(F);
+
+    static void add(const uint8_t* px, ChannelSums& sums)
+    {
+        if constexpr (F == PixelFormat::rgb565) {
+            unsigned value = px[0] | (px[1] << 8);
+            unsigned r = value >> 11, g = (value >> 5) & 0x3F, b = value & 0x1F;
+            sums.r += (r << 3) | (r >> 2);
+            sums.g += (g << 2) | (g >> 4);
+            sums.b += (b << 3) | (b >> 2);
+        } else if constexpr (F == PixelFormat::rgba32 || F == PixelFormat::rgb24) {
+            sums.r += px[0];
+            sums.g += px[1];
+            sums.b += px[2];
+        } else {
+            sums.b += px[0];
+            sums.g += px[1];
+            sums.r += px[2];
+        }
+    }
+};
+
+/** Adds `pixels` consecutive pixels of format `F`; the portable path for formats without a SIMD kernel. */
+template <PixelFormat F>
+void sum_row(const uint8_t* row, int pixels, ChannelSums& sums)
+{
+    const uint8_t* end = row + pixels * PixelTraits<F>::bytes;
+    for (const uint8_t* px = row; px < end; px += PixelTraits<F>::bytes)
+        PixelTraits<F>::add(px, sums);
+}
+
+/** Adds every `step`-th pixel of a run of `pixels`, starting with the first. */
+template <PixelFormat F>
+void sum_row_strided(const uint8_t* row, int pixels, int step, ChannelSums& sums)
+{
+    int advance = step * PixelTraits<F>::bytes;
+    const uint8_t* end = row + pixels * PixelTraits<F>::bytes;
+    for (const uint8_t* px = row; px < end; px += advance)
+        PixelTraits<F>::add(px, sums);
+}
+
+/** Picks the fastest BGRA kernel the running CPU supports. */
+RowSumKernel select_bgra_kernel();
+const char* bgra_kernel_name(RowSumKernel kernel);
@@ -1,4 +1,5 @@
 #include "capture.hpp"
+#include "raw_source.hpp"
 
 #if defined(_WIN32) || defined(_WIN64)
 #include <windows.h>
@@ -16,7 +17,8 @@ class ScreenCaptureImpl
     std::vector<uint8_t> buffer_;
     float last_percent_;
 
-    ScreenCaptureImpl() : hdc_screen_(nullptr), hdc_mem_(nullptr), hbitmap_(nullptr), last_percent_(0.0f)
+    /** monitor selection is X11 only, GDI always captures the primary screen */
+    explicit ScreenCaptureImpl(const std::string&) : hdc_screen_(nullptr), hdc_mem_(nullptr), hbitmap_(nullptr), last_percent_(0.0f)
     {
         hdc_screen_ = GetDC(nullptr);
         screen_width_ = GetDeviceCaps(hdc_screen_, HORZRES);
@@ -32,6 +34,11 @@ class ScreenCaptureImpl
     }
 
     bool capture(float percent)
+    {
+        return capture_into(percent, buffer_);
+    }
+
+    bool capture_into(float percent, std::vector<uint8_t>& out)
     {
         percent = max(0.01f, min(1.0f, percent));
         capture_width_ = static_cast<int>(screen_width_ * percent);
@@ -56,29 +63,97 @@ class ScreenCaptureImpl
         bi.biBitCount = 32;
         bi.biCompression = BI_RGB;
 
-        buffer_.resize(capture_width_ * capture_height_ * 4);
-        return GetDIBits(hdc_mem_, hbitmap_, 0, capture_height_, buffer_.data(), (BITMAPINFO*)&bi, DIB_RGB_COLORS) != 0;
+        out.resize(capture_width_ * capture_height_ * 4);
+        return GetDIBits(hdc_mem_, hbitmap_, 0, capture_height_, out.data(), (BITMAPINFO*)&bi, DIB_RGB_COLORS) != 0;
+    }
+
+    /** GDI has no cheap partial readback, so the strips are views into a full capture */
+    bool capture_border(float percent, int depth, const std::vector<ImageRect>*, int buffer)
+    {
+        std::vector<uint8_t>& pixels = border_buffers_[buffer];
+        if (!capture_into(percent, pixels)) return false;
+
+        int d = min(depth, min(capture_width_, capture_height_) / 2);
+        int stride = capture_width_ * 4;
+        BorderStrips& border = border_[buffer];
+        border.width = capture_width_;
+        border.height = capture_height_;
+        border.depth = d;
+        border.format = PixelFormat::bgrx32;
+        border.top = { pixels.data(), stride };
+        border.bottom = { pixels.data() + (capture_height_ - d) * stride, stride };
+        border.left = { pixels.data() + d * stride, stride };
+        border.right = { pixels.data() + d * stride + (capture_width_ - d) * 4, stride };
+        return true;
+    }
+
+    const BorderStrips& border(int buffer) const
+    {
+        return border_[buffer];
+    }
+
+    /** no change notification on GDI, every frame counts as damaged */
+    bool poll_damage(std::vector<ImageRect>& damage)
+    {
+        damage.clear();
+        return false;
     }
 
     int bytes_per_pixel() const
     {
         return 4;
     }
+
+    /** 32-bit DIB rows are never padded and leave the top byte undefined */
+    ImageView image() const
+    {
+        return { buffer_.data(), capture_width_, capture_height_, capture_width_ * 4, PixelFormat::bgrx32 };
+    }
+
+    std::vector<uint8_t> border_buffers_[ScreenCapture::k_border_buffers];
+    BorderStrips border_[ScreenCapture::k_border_buffers];
 };
 
 #else
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <X11/extensions/XShm.h>
+#include <X11/extensions/Xdamage.h>
+#include <X11/extensions/Xfixes.h>
+#include <X11/extensions/Xrandr.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
 #include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
 
 class ScreenCaptureImpl
 {
   public:
+    /** An XImage plus the shared memory segment backing it, if any. */
+    struct ShmImage
+    {
+        XImage* ximg = nullptr;
+        XShmSegmentInfo shminfo{};
+    };
+
+    enum Edge
+    {
+        top,
+        bottom,
+        left,
+        right,
+        edge_count
+    };
+
     Display* dpy_;
     Window root_;
+    /** XRandR output name or index to confine capture to, empty for the whole root window */
+    std::string monitor_;
+    /** the area `percent` is taken of: the selected monitor's CRTC, or the root window; empty while the monitor is gone */
+    int area_x_, area_y_;
     int screen_width_, screen_height_;
     int capture_width_, capture_height_;
     int capture_x_, capture_y_;
@@ -87,76 +162,297 @@ class ScreenCaptureImpl
     bool use_shm_;
     XShmSegmentInfo shminfo_;
     float last_percent_;
+    /** layout of the images created last, all of them share the default visual */
+    PixelFormat format_ = PixelFormat::bgrx32;
+    bool format_warned_ = false;
 
-    ScreenCaptureImpl() : dpy_(nullptr), img_data_(nullptr), ximg_(nullptr), use_shm_(false), last_percent_(0.0f)
+    /** One set of border images; several let a pipeline capture into one while another is analyzed. */
+    struct StripSet
+    {
+        ShmImage strips[edge_count];
+        int width[edge_count] = {};
+        int height[edge_count] = {};
+        BorderStrips border;
+    };
+
+    StripSet sets_[ScreenCapture::k_border_buffers];
+    int last_set_ = -1;
+
+    Damage damage_;
+    XserverRegion damage_region_;
+    int damage_event_base_;
+    bool damage_notified_ = false;
+
+    bool randr_ = false;
+    int randr_event_base_ = 0;
+    /** the area moved or changed size since the last poll_damage(), so the next frame has to be complete */
+    bool geometry_changed_ = false;
+    bool geometry_dirty_ = false;
+
+    explicit ScreenCaptureImpl(const std::string& monitor)
+        : dpy_(nullptr), monitor_(monitor), area_x_(0), area_y_(0), screen_width_(0), screen_height_(0), capture_x_(0), capture_y_(0), img_data_(nullptr),
+          ximg_(nullptr), use_shm_(false), last_percent_(0.0f), damage_(0), damage_region_(0), damage_event_base_(0)
     {
         dpy_ = XOpenDisplay(nullptr);
         if (!dpy_) return;
         root_ = DefaultRootWindow(dpy_);
-        XWindowAttributes attr;
-        XGetWindowAttributes(dpy_, root_, &attr);
-        screen_width_ = attr.width;
-        screen_height_ = attr.height;
         use_shm_ = XShmQueryExtension(dpy_);
+
+        /** hotplug, mode and layout changes re-read the geometry on the next frame */
+        int randr_error_base;
+        randr_ = XRRQueryExtension(dpy_, &randr_event_base_, &randr_error_base);
+        if (randr_) XRRSelectInput(dpy_, root_, RRScreenChangeNotifyMask | RRCrtcChangeNotifyMask | RROutputChangeNotifyMask);
+        XSelectInput(dpy_, root_, StructureNotifyMask);
+        refresh_geometry();
+        if (!monitor_.empty() && screen_width_ == 0) {
+            std::fprintf(stderr, "Warning: monitor '%s' is not connected, waiting for it\n", monitor_.c_str());
+        }
+
+        /** report only the empty -> non-empty transition, the areas are fetched in poll_damage() */
+        int damage_error_base, fixes_event_base, fixes_error_base;
+        if (XDamageQueryExtension(dpy_, &damage_event_base_, &damage_error_base) && XFixesQueryExtension(dpy_, &fixes_event_base, &fixes_error_base)) {
+            damage_ = XDamageCreate(dpy_, root_, XDamageReportNonEmpty);
+            damage_region_ = XFixesCreateRegion(dpy_, nullptr, 0);
+        }
     }
 
     ~ScreenCaptureImpl()
     {
         cleanup();
+        for (auto& set : sets_)
+            cleanup_strips(set);
+        if (damage_) XDamageDestroy(dpy_, damage_);
+        if (damage_region_) XFixesDestroyRegion(dpy_, damage_region_);
         if (dpy_) XCloseDisplay(dpy_);
     }
 
+    /**
+     * Re-reads the area to capture: the CRTC of the output named `monitor_` (or the n-th
+     * enabled output if it is a number), or the whole root window. The area stays empty while
+     * the selected output is disconnected or switched off.
+     */
+    void refresh_geometry()
+    {
+        geometry_dirty_ = false;
+        geometry_changed_ = true;
+        last_set_ = -1;
+        area_x_ = area_y_ = 0;
+
+        if (monitor_.empty()) {
+            XWindowAttributes attr;
+            XGetWindowAttributes(dpy_, root_, &attr);
+            screen_width_ = attr.width;
+            screen_height_ = attr.height;
+            return;
+        }
+
+        screen_width_ = screen_height_ = 0;
+        if (!randr_) return;
+        XRRScreenResources* res = XRRGetScreenResourcesCurrent(dpy_, root_);
+        if (!res) return;
+
+        char* end = nullptr;
+        long index = std::strtol(monitor_.c_str(), &end, 10);
+        bool by_index = *end == '\0';
+        long enabled_index = 0;
+        for (int i = 0; i < res->noutput; ++i) {
+            XRROutputInfo* output = XRRGetOutputInfo(dpy_, res, res->outputs[i]);
+            if (!output) continue;
+
+            bool enabled = output->connection == RR_Connected && output->crtc;
+            bool match = enabled && (by_index ? enabled_index++ == index : monitor_ == output->name);
+            if (match) {
+                if (XRRCrtcInfo* crtc = XRRGetCrtcInfo(dpy_, res, output->crtc)) {
+                    area_x_ = crtc->x;
+                    area_y_ = crtc->y;
+                    screen_width_ = static_cast<int>(crtc->width);
+                    screen_height_ = static_cast<int>(crtc->height);
+                    XRRFreeCrtcInfo(crtc);
+                }
+            }
+            XRRFreeOutputInfo(output);
+            if (match) break;
+        }
+        XRRFreeScreenResources(res);
+    }
+
+    /** Drains the event queue, noting damage and any change to the screen or output configuration. */
+    void pump_events()
+    {
+        while (XPending(dpy_)) {
+            XEvent ev;
+            XNextEvent(dpy_, &ev);
+            if (damage_ && ev.type == damage_event_base_ + XDamageNotify) {
+                damage_notified_ = true;
+            } else if (randr_ && (ev.type == randr_event_base_ + RRScreenChangeNotify || ev.type == randr_event_base_ + RRNotify)) {
+                XRRUpdateConfiguration(&ev);
+                geometry_dirty_ = true;
+            } else if (ev.type == ConfigureNotify && ev.xconfigure.window == root_) {
+                geometry_dirty_ = true;
+            }
+        }
+        if (geometry_dirty_) refresh_geometry();
+    }
+
+    /**
+     * Drains pending damage notifications and returns the changed areas in capture coordinates,
+     * clipped to the capture area so that drawing on other monitors is not reported.
+     * Returns false when XDamage is unavailable or the capture area just changed, and the caller
+     * has to assume everything changed.
+     */
+    bool poll_damage(std::vector<ImageRect>& damage)
+    {
+        damage.clear();
+        if (!dpy_) return false;
+        pump_events();
+        if (!damage_) return false;
+
+        if (geometry_changed_) {
+            geometry_changed_ = false;
+            damage_notified_ = false;
+            XDamageSubtract(dpy_, damage_, None, None);
+            return false;
+        }
+        if (!damage_notified_) return true;
+        damage_notified_ = false;
+
+        XDamageSubtract(dpy_, damage_, None, damage_region_);
+        int count = 0;
+        XRectangle* rects = XFixesFetchRegion(dpy_, damage_region_, &count);
+        for (int i = 0; i < count; ++i) {
+            int x0 = std::max<int>(rects[i].x, capture_x_), y0 = std::max<int>(rects[i].y, capture_y_);
+            int x1 = std::min(rects[i].x + rects[i].width, capture_x_ + capture_width_);
+            int y1 = std::min(rects[i].y + rects[i].height, capture_y_ + capture_height_);
+            if (x1 > x0 && y1 > y0) damage.push_back({ x0 - capture_x_, y0 - capture_y_, x1 - x0, y1 - y0 });
+        }
+        if (rects) XFree(rects);
+        return true;
+    }
+
+    /**
+     * Notes the pixel format of a newly created image, so it is determined once per image
+     * geometry rather than per frame. Layouts without an analyzer kernel are read as BGRX.
+     */
+    void update_format(const XImage* img)
+    {
+        bool lsb = img->byte_order == LSBFirst;
+        bool rgb888 = img->red_mask == 0xFF0000 && img->green_mask == 0xFF00 && img->blue_mask == 0xFF;
+        if (lsb && rgb888 && img->bits_per_pixel == 32) {
+            format_ = img->depth == 32 ? PixelFormat::bgra32 : PixelFormat::bgrx32;
+        } else if (lsb && rgb888 && img->bits_per_pixel == 24) {
+            format_ = PixelFormat::bgr24;
+        } else if (lsb && img->bits_per_pixel == 16 && img->red_mask == 0xF800 && img->green_mask == 0x07E0 && img->blue_mask == 0x1F) {
+            format_ = PixelFormat::rgb565;
+        } else {
+            format_ = PixelFormat::bgrx32;
+            if (!format_warned_) {
+                std::fprintf(stderr, "Warning: unsupported %d bpp visual (masks %lx/%lx/%lx), colors will be wrong\n", img->bits_per_pixel, img->red_mask, img->green_mask,
+                             img->blue_mask);
+                format_warned_ = true;
+            }
+        }
+    }
+
+    /**
+     * Creates a ZPixmap image backed by a fresh shared memory segment.
+     * Returns nullptr when the segment cannot be created or attached.
+     */
+    XImage* create_shm_image(XShmSegmentInfo& info, int width, int height)
+    {
+        XImage* img = XShmCreateImage(dpy_, DefaultVisual(dpy_, DefaultScreen(dpy_)), DefaultDepth(dpy_, DefaultScreen(dpy_)), ZPixmap, nullptr, &info, width, height);
+        if (!img) return nullptr;
+        update_format(img);
+
+        info.shmid = shmget(IPC_PRIVATE, img->bytes_per_line * img->height, IPC_CREAT | 0777);
+        if (info.shmid == -1) {
+            XDestroyImage(img);
+            return nullptr;
+        }
+
+        info.shmaddr = img->data = static_cast<char*>(shmat(info.shmid, 0, 0));
+        if (info.shmaddr == (char*)-1) {
+            shmctl(info.shmid, IPC_RMID, 0);
+            img->data = nullptr;
+            XDestroyImage(img);
+            return nullptr;
+        }
+
+        info.readOnly = False;
+        if (!XShmAttach(dpy_, &info)) {
+            shmctl(info.shmid, IPC_RMID, 0);
+            shmdt(info.shmaddr);
+            img->data = nullptr;
+            XDestroyImage(img);
+            use_shm_ = false;
+            return nullptr;
+        }
+
+        XSync(dpy_, False);
+        shmctl(info.shmid, IPC_RMID, 0);
+        return img;
+    }
+
+    void destroy_shm_image(XImage* img, XShmSegmentInfo& info)
+    {
+        XShmDetach(dpy_, &info);
+        XDestroyImage(img);
+        shmdt(info.shmaddr);
+    }
+
     void cleanup()
     {
-        if (use_shm_) {
-            if (ximg_) {
-                XShmDetach(dpy_, &shminfo_);
+        if (ximg_) {
+            if (use_shm_) {
+                destroy_shm_image(ximg_, shminfo_);
+            } else {
                 XDestroyImage(ximg_);
-                shmdt(shminfo_.shmaddr);
             }
-        } else {
-            if (ximg_) XDestroyImage(ximg_);
         }
         ximg_ = nullptr;
         img_data_ = nullptr;
     }
 
-    void reallocate_shm(int width, int height)
+    void cleanup_strips(StripSet& set)
     {
-        cleanup();
-        ximg_ = XShmCreateImage(dpy_, DefaultVisual(dpy_, DefaultScreen(dpy_)), DefaultDepth(dpy_, DefaultScreen(dpy_)), ZPixmap, nullptr, &shminfo_, width, height);
-        if (ximg_) {
-            shminfo_.shmid = shmget(IPC_PRIVATE, ximg_->bytes_per_line * ximg_->height, IPC_CREAT | 0777);
-            if (shminfo_.shmid != -1) {
-                shminfo_.shmaddr = ximg_->data = static_cast<char*>(shmat(shminfo_.shmid, 0, 0));
-                if (shminfo_.shmaddr != (char*)-1) {
-                    shminfo_.readOnly = False;
-                    if (XShmAttach(dpy_, &shminfo_)) {
-                        XSync(dpy_, False);
-                        shmctl(shminfo_.shmid, IPC_RMID, 0);
-                        img_data_ = reinterpret_cast<uint8_t*>(ximg_->data);
-                    } else {
-                        use_shm_ = false;
-                        cleanup();
-                    }
+        for (auto& strip : set.strips) {
+            if (strip.ximg) {
+                if (strip.shminfo.shmaddr) {
+                    destroy_shm_image(strip.ximg, strip.shminfo);
                 } else {
-                    shmctl(shminfo_.shmid, IPC_RMID, 0);
+                    XDestroyImage(strip.ximg);
                 }
             }
+            strip = ShmImage{};
         }
     }
 
+    void reallocate_shm(int width, int height)
+    {
+        cleanup();
+        ximg_ = create_shm_image(shminfo_, width, height);
+        if (ximg_) img_data_ = reinterpret_cast<uint8_t*>(ximg_->data);
+    }
+
+    /** Centers the `percent` rectangle on the capture area; returns false while the area is empty. */
+    bool update_geometry(float percent)
+    {
+        pump_events();
+        capture_width_ = static_cast<int>(screen_width_ * percent);
+        capture_height_ = static_cast<int>(screen_height_ * percent);
+        capture_x_ = area_x_ + (screen_width_ - capture_width_) / 2;
+        capture_y_ = area_y_ + (screen_height_ - capture_height_) / 2;
+        return capture_width_ > 0 && capture_height_ > 0;
+    }
+
     bool capture(float percent)
     {
         if (!dpy_) return false;
         percent = std::max(0.01f, std::min(1.0f, percent));
-        capture_width_ = static_cast<int>(screen_width_ * percent);
-        capture_height_ = static_cast<int>(screen_height_ * percent);
-        capture_x_ = (screen_width_ - capture_width_) / 2;
-        capture_y_ = (screen_height_ - capture_height_) / 2;
+        if (!update_geometry(percent)) return false;
 
         if (use_shm_) {
-            if (percent != last_percent_) {
+            /** the segment follows the capture size, which changes with percent and the monitor mode */
+            if (!ximg_ || ximg_->width != capture_width_ || ximg_->height != capture_height_) {
                 reallocate_shm(capture_width_, capture_height_);
                 last_percent_ = percent;
             }
@@ -167,43 +463,168 @@ class ScreenCaptureImpl
             if (ximg_) XDestroyImage(ximg_);
             ximg_ = XGetImage(dpy_, root_, capture_x_, capture_y_, capture_width_, capture_height_, AllPlanes, ZPixmap);
             if (!ximg_) return false;
+            update_format(ximg_);
             img_data_ = reinterpret_cast<uint8_t*>(ximg_->data);
             last_percent_ = percent;
         }
         return true;
     }
 
+    /**
+     * Fetches only the four `depth`-pixel edges of the centered `percent` rectangle,
+     * each into its own small SHM image of strip set `buffer`.
+     */
+    bool capture_border(float percent, int depth, const std::vector<ImageRect>* damage, int buffer)
+    {
+        if (!dpy_) return false;
+        percent = std::max(0.01f, std::min(1.0f, percent));
+        if (!update_geometry(percent)) return false;
+
+        StripSet& set = sets_[buffer];
+        int d = std::max(1, std::min(depth, std::min(capture_width_, capture_height_) / 2));
+        int side_height = capture_height_ - 2 * d;
+
+        int xs[edge_count] = { capture_x_, capture_x_, capture_x_, capture_x_ + capture_width_ - d };
+        int ys[edge_count] = { capture_y_, capture_y_ + capture_height_ - d, capture_y_ + d, capture_y_ + d };
+        int ws[edge_count] = { capture_width_, capture_width_, d, d };
+        int hs[edge_count] = { d, d, side_height, side_height };
+
+        bool resized = false;
+        for (int e = 0; e < edge_count; ++e)
+            resized |= ws[e] != set.width[e] || hs[e] != set.height[e];
+
+        if (resized && use_shm_) {
+            cleanup_strips(set);
+            for (int e = 0; e < edge_count; ++e) {
+                if (ws[e] > 0 && hs[e] > 0) set.strips[e].ximg = create_shm_image(set.strips[e].shminfo, ws[e], hs[e]);
+            }
+            if (!use_shm_) cleanup_strips(set);
+        }
+        for (int e = 0; e < edge_count; ++e) {
+            set.width[e] = ws[e];
+            set.height[e] = hs[e];
+        }
+
+        /** skipping untouched strips is only valid when this set holds the previous frame */
+        bool partial = damage && !resized && buffer == last_set_;
+        last_set_ = buffer;
+
+        for (int e = 0; e < edge_count; ++e) {
+            if (ws[e] <= 0 || hs[e] <= 0) continue;
+
+            /** a strip nothing was drawn over still holds the right pixels from the last fetch */
+            if (partial && set.strips[e].ximg) {
+                int x = xs[e] - capture_x_, y = ys[e] - capture_y_;
+                bool touched = std::any_of(damage->begin(), damage->end(), [&](const ImageRect& r) {
+                    return x < r.x + r.width && r.x < x + ws[e] && y < r.y + r.height && r.y < y + hs[e];
+                });
+                if (!touched) continue;
+            }
+
+            if (use_shm_) {
+                if (!set.strips[e].ximg) return false;
+                if (!XShmGetImage(dpy_, root_, set.strips[e].ximg, xs[e], ys[e], AllPlanes)) return false;
+            } else {
+                if (set.strips[e].ximg) XDestroyImage(set.strips[e].ximg);
+                set.strips[e].ximg = XGetImage(dpy_, root_, xs[e], ys[e], ws[e], hs[e], AllPlanes, ZPixmap);
+                if (!set.strips[e].ximg) return false;
+                update_format(set.strips[e].ximg);
+            }
+        }
+
+        auto view = [&](Edge e) {
+            XImage* img = set.strips[e].ximg;
+            return img ? ImageStrip{ reinterpret_cast<const uint8_t*>(img->data), img->bytes_per_line } : ImageStrip{};
+        };
+
+        BorderStrips& border = set.border;
+        border.width = capture_width_;
+        border.height = capture_height_;
+        border.depth = d;
+        border.format = format_;
+        border.top = view(top);
+        border.bottom = view(bottom);
+        border.left = view(left);
+        border.right = view(right);
+        return true;
+    }
+
+    const BorderStrips& border(int buffer) const
+    {
+        return sets_[buffer].border;
+    }
+
     int bytes_per_pixel() const
     {
         return ximg_ ? ximg_->bits_per_pixel / 8 : 4;
     }
+
+    /** XImage rows are padded to the scanline unit, so the stride is bytes_per_line rather than width * bpp */
+    ImageView image() const
+    {
+        if (!ximg_) return {};
+        return { img_data_, capture_width_, capture_height_, ximg_->bytes_per_line, format_ };
+    }
 };
 #endif
 
-ScreenCapture::ScreenCapture() : impl_(std::make_unique<ScreenCaptureImpl>())
+static_assert(RawFrameSource::k_border_buffers == ScreenCapture::k_border_buffers, "raw sources fill the same strip sets");
+
+/** the X or GDI implementation is only created without a raw source, which needs no display */
+ScreenCapture::ScreenCapture(const std::string& monitor, const std::string& source)
 {
+    if (source.empty()) {
+        impl_ = std::make_unique<ScreenCaptureImpl>(monitor);
+    } else {
+        raw_ = std::make_unique<RawFrameSource>(source);
+    }
 }
 ScreenCapture::~ScreenCapture() = default;
 
 bool ScreenCapture::capture(float percent)
 {
+    if (raw_) return raw_->capture(percent);
     return impl_->capture(percent);
 }
+bool ScreenCapture::capture_border(float percent, int depth, const std::vector<ImageRect>* damage, int buffer)
+{
+    if (raw_) return raw_->capture_border(percent, depth, buffer);
+    return impl_->capture_border(percent, depth, damage, buffer);
+}
+bool ScreenCapture::poll_damage(std::vector<ImageRect>& damage)
+{
+    if (raw_) return raw_->poll_damage(damage);
+    return impl_->poll_damage(damage);
+}
+const BorderStrips& ScreenCapture::border(int buffer) const
+{
+    if (raw_) return raw_->border(buffer);
+    return impl_->border(buffer);
+}
 int ScreenCapture::width() const
 {
+    if (raw_) return raw_->width();
     return impl_->capture_width_;
 }
 int ScreenCapture::height() const
 {
+    if (raw_) return raw_->height();
     return impl_->capture_height_;
 }
 int ScreenCapture::bytes_per_pixel() const
 {
+    if (raw_) return ::bytes_per_pixel(raw_->format());
     return impl_->bytes_per_pixel();
 }
+ImageView ScreenCapture::image() const
+{
+    if (raw_) return raw_->image();
+    return impl_->image();
+}
 
 uint8_t* ScreenCapture::data() const
 {
+    if (raw_) return const_cast<uint8_t*>(raw_->image().data);
 #if defined(_WIN32) || defined(_WIN64)
     return impl_->buffer_.data();
 #else
@@ -9,7 +9,8 @@ color::color(uint8_t red, uint8_t green, uint8_t blue) : r(red), g(green), b(blu
 
 color color::scaled(double brightness) const
 {
-    return { static_cast<uint8_t>(r * brightness), static_cast<uint8_t>(g * brightness), static_cast<uint8_t>(b * brightness) };
+    uint32_t level = brightness_level(brightness);
+    return { static_cast<uint8_t>(r * level >> 16), static_cast<uint8_t>(g * level >> 16), static_cast<uint8_t>(b * level >> 16) };
 }
 
-} // namespace led
\ No newline at end of file
+} // namespace led
@@ -0,0 +1,25 @@
+#include "color_encoder.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace led
+{
+
+color_encoder::color_encoder(double gamma, bool dither) : dither_(dither)
+{
+    set_gamma(gamma);
+}
+
+void color_encoder::set_gamma(double gamma)
+{
+    gamma_ = gamma > 0.0 ? gamma : 1.0;
+
+    /** sampled at the low edge of each entry so a gamma of 1.0 maps every 8-bit level onto itself */
+    constexpr double full = 0xFF00;
+    for (size_t i = 0; i < lut_.size(); ++i) {
+        double x = std::min(1.0, (i << k_frac_bits) / full);
+        lut_[i] = static_cast<uint16_t>(std::lround(std::pow(x, gamma_) * full));
+    }
+}
+
+} // namespace led
@@ -0,0 +1,229 @@
+#include "compositor.hpp"
+#include "cpu_features.hpp"
+#include <algorithm>
+
+#ifdef NLCTL_X86
+#include <immintrin.h>
+#endif
+
+namespace led
+{
+
+static_assert(sizeof(color16) == 3 * sizeof(uint16_t), "the blend kernels see a color16 array as plain channels");
+
+/**
+ * One channel of `src` blended onto `dst`. The SIMD kernels build the same values from
+ * saturating 16-bit operations: multiply takes the high half of the product and adds 1/256 of
+ * it in place of dividing by 0xFF00, which is off by less than 3/256 of an 8-bit step.
+ */
+template <blend_mode M>
+static uint32_t blend_channel(uint32_t dst, uint32_t src)
+{
+    if constexpr (M == blend_mode::alpha) {
+        return src;
+    } else if constexpr (M == blend_mode::add) {
+        return std::min<uint32_t>(dst + src, 0xFF00);
+    } else if constexpr (M == blend_mode::multiply) {
+        uint32_t high = dst * src >> 16;
+        return std::min<uint32_t>(high + (high >> 8), 0xFFFF);
+    } else {
+        return std::max(dst, src);
+    }
+}
+
+template <blend_mode M>
+static void blend_scalar(uint16_t* dst, const uint16_t* src, size_t count, uint32_t opacity)
+{
+    if (opacity == 0) return;
+    if (opacity >= k_opaque) {
+        for (size_t i = 0; i < count; ++i)
+            dst[i] = static_cast<uint16_t>(blend_channel<M>(dst[i], src[i]));
+        return;
+    }
+
+    uint32_t keep = k_opaque - opacity;
+    for (size_t i = 0; i < count; ++i)
+        dst[i] = static_cast<uint16_t>((dst[i] * keep >> 16) + (blend_channel<M>(dst[i], src[i]) * opacity >> 16));
+}
+
+/** Picks the instantiation of a kernel template for `mode`. */
+template <blend_kernel Alpha, blend_kernel Add, blend_kernel Multiply, blend_kernel Max>
+static blend_kernel pick(blend_mode mode)
+{
+    switch (mode) {
+        case blend_mode::alpha: return Alpha;
+        case blend_mode::add: return Add;
+        case blend_mode::multiply: return Multiply;
+        case blend_mode::max: return Max;
+    }
+    return Alpha;
+}
+
+blend_kernel blend_kernel_scalar(blend_mode mode)
+{
+    return pick<blend_scalar<blend_mode::alpha>, blend_scalar<blend_mode::add>, blend_scalar<blend_mode::multiply>, blend_scalar<blend_mode::max>>(mode);
+}
+
+#ifdef NLCTL_X86
+
+/** SSE2 has no unsigned 16-bit min and max, saturating subtraction stands in for both. */
+template <blend_mode M>
+NLCTL_TARGET("sse2") static inline __m128i blend_vector(__m128i dst, __m128i src)
+{
+    if constexpr (M == blend_mode::alpha) {
+        return src;
+    } else if constexpr (M == blend_mode::add) {
+        __m128i sum = _mm_adds_epu16(dst, src);
+        return _mm_sub_epi16(sum, _mm_subs_epu16(sum, _mm_set1_epi16(static_cast<short>(0xFF00))));
+    } else if constexpr (M == blend_mode::multiply) {
+        __m128i high = _mm_mulhi_epu16(dst, src);
+        return _mm_adds_epu16(high, _mm_srli_epi16(high, 8));
+    } else {
+        return _mm_add_epi16(src, _mm_subs_epu16(dst, src));
+    }
+}
+
+template <blend_mode M>
+NLCTL_TARGET("sse2") static void blend_sse2(uint16_t* dst, const uint16_t* src, size_t count, uint32_t opacity)
+{
+    if (opacity == 0) return;
+
+    size_t i = 0;
+    if (opacity >= k_opaque) {
+        for (; i + 8 <= count; i += 8) {
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+            __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), blend_vector<M>(d, s));
+        }
+    } else {
+        const __m128i alpha = _mm_set1_epi16(static_cast<short>(opacity));
+        const __m128i keep = _mm_set1_epi16(static_cast<short>(k_opaque - opacity));
+        for (; i + 8 <= count; i += 8) {
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+            __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            __m128i mixed = _mm_add_epi16(_mm_mulhi_epu16(d, keep), _mm_mulhi_epu16(blend_vector<M>(d, s), alpha));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), mixed);
+        }
+    }
+    blend_scalar<M>(dst + i, src + i, count - i, opacity);
+}
+
+template <blend_mode M>
+NLCTL_TARGET("avx2") static inline __m256i blend_vector(__m256i dst, __m256i src)
+{
+    if constexpr (M == blend_mode::alpha) {
+        return src;
+    } else if constexpr (M == blend_mode::add) {
+        return _mm256_min_epu16(_mm256_adds_epu16(dst, src), _mm256_set1_epi16(static_cast<short>(0xFF00)));
+    } else if constexpr (M == blend_mode::multiply) {
+        __m256i high = _mm256_mulhi_epu16(dst, src);
+        return _mm256_adds_epu16(high, _mm256_srli_epi16(high, 8));
+    } else {
+        return _mm256_max_epu16(dst, src);
+    }
+}
+
+template <blend_mode M>
+NLCTL_TARGET("avx2") static void blend_avx2(uint16_t* dst, const uint16_t* src, size_t count, uint32_t opacity)
+{
+    if (opacity == 0) return;
+
+    size_t i = 0;
+    if (opacity >= k_opaque) {
+        for (; i + 16 <= count; i += 16) {
+            __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+            __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), blend_vector<M>(d, s));
+        }
+    } else {
+        const __m256i alpha = _mm256_set1_epi16(static_cast<short>(opacity));
+        const __m256i keep = _mm256_set1_epi16(static_cast<short>(k_opaque - opacity));
+        for (; i + 16 <= count; i += 16) {
+            __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+            __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+            __m256i mixed = _mm256_add_epi16(_mm256_mulhi_epu16(d, keep), _mm256_mulhi_epu16(blend_vector<M>(d, s), alpha));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), mixed);
+        }
+    }
+
+    /** under 16 channels are left: at most one 8-channel SSE2 vector, then scalar */
+    _mm256_zeroupper();
+    blend_sse2<M>(dst + i, src + i, count - i, opacity);
+}
+
+blend_kernel blend_kernel_sse2(blend_mode mode)
+{
+    return pick<blend_sse2<blend_mode::alpha>, blend_sse2<blend_mode::add>, blend_sse2<blend_mode::multiply>, blend_sse2<blend_mode::max>>(mode);
+}
+
+blend_kernel blend_kernel_avx2(blend_mode mode)
+{
+    return pick<blend_avx2<blend_mode::alpha>, blend_avx2<blend_mode::add>, blend_avx2<blend_mode::multiply>, blend_avx2<blend_mode::max>>(mode);
+}
+
+blend_kernel select_blend_kernel(blend_mode mode)
+{
+    if (cpu_has_avx2()) return blend_kernel_avx2(mode);
+    if (cpu_has_sse2()) return blend_kernel_sse2(mode);
+    return blend_kernel_scalar(mode);
+}
+
+#else
+
+blend_kernel blend_kernel_sse2(blend_mode mode)
+{
+    return blend_kernel_scalar(mode);
+}
+
+blend_kernel blend_kernel_avx2(blend_mode mode)
+{
+    return blend_kernel_scalar(mode);
+}
+
+blend_kernel select_blend_kernel(blend_mode mode)
+{
+    return blend_kernel_scalar(mode);
+}
+
+#endif
+
+void compositor::add_layer(std::unique_ptr<renderer> source, blend_mode mode, uint32_t opacity)
+{
+    layers_.push_back({ std::move(source), mode, std::min(opacity, k_opaque), select_blend_kernel(mode) });
+}
+
+void compositor::set_opacity(size_t layer, uint32_t opacity)
+{
+    layers_.at(layer).opacity = std::min(opacity, k_opaque);
+}
+
+void compositor::compose(renderer::clock::time_point now, std::span<color16> out)
+{
+    /** an opaque alpha layer hides everything below it, so those are not even rendered */
+    size_t base = layers_.size();
+    for (size_t i = layers_.size(); i-- > 0;) {
+        if (layers_[i].mode == blend_mode::alpha && layers_[i].opacity >= k_opaque) {
+            base = i;
+            break;
+        }
+    }
+
+    size_t next = 0;
+    if (base < layers_.size()) {
+        layers_[base].source->render(now, out);
+        next = base + 1;
+    } else {
+        std::fill(out.begin(), out.end(), color16{ 0, 0, 0 });
+    }
+
+    scratch_.resize(out.size());
+    uint16_t* channels = reinterpret_cast<uint16_t*>(out.data());
+    for (; next < layers_.size(); ++next) {
+        const layer& l = layers_[next];
+        if (l.opacity == 0) continue;
+        l.source->render(now, scratch_);
+        l.kernel(channels, reinterpret_cast<const uint16_t*>(scratch_.data()), out.size() * 3, l.opacity);
+    }
+}
+
+} // namespace led
@@ -0,0 +1,219 @@
+#include "control_daemon.hpp"
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace led
+{
+
+static const char* mode_name(animation_mode mode)
+{
+    switch (mode) {
+        case animation_mode::solid: return "solid";
+        case animation_mode::breathing: return "breathing";
+        case animation_mode::wave: return "wave";
+        case animation_mode::rainbow: return "rainbow";
+        case animation_mode::screen_zones: return "reactive";
+    }
+    return "unknown";
+}
+
+control_daemon::control_daemon(std::vector<hid_device_wrapper*> devices, daemon_settings settings) : devices_(std::move(devices)), settings_(std::move(settings))
+{
+    if (devices_.empty()) throw std::runtime_error("The daemon needs at least one strip");
+    if (settings_.layouts.empty()) settings_.layouts.emplace_back();
+    show(settings_.mode);
+}
+
+control_daemon::~control_daemon()
+{
+    stop();
+}
+
+zone_layout control_daemon::layout_of(size_t strip) const
+{
+    return settings_.layouts[std::min(strip, settings_.layouts.size() - 1)];
+}
+
+void control_daemon::configure(animation_base& anim) const
+{
+    anim.encoder().set_gamma(settings_.gamma);
+    anim.encoder().set_dither(settings_.dither);
+    anim.set_overrun_policy(settings_.overrun);
+}
+
+screen_zone_animation& control_daemon::screen()
+{
+    if (!screen_) {
+        auto s = settings_.screen;
+        s.report_stats = settings_.report_stats;
+        screen_ = std::make_unique<screen_zone_animation>(*devices_[0], layout_of(0), s);
+        for (size_t i = 1; i < devices_.size(); ++i)
+            screen_->add_strip(*devices_[i], layout_of(i));
+        configure(*screen_);
+    }
+    return *screen_;
+}
+
+/** Lets every running animation finish its frame and waits for its thread. */
+void control_daemon::stop()
+{
+    if (screen_) screen_->stop();
+    for (auto& anim : anims_)
+        anim->stop();
+    for (auto& thread : threads_)
+        thread.join();
+    threads_.clear();
+}
+
+/** Runs the animations of settings_.mode, one thread each; a solid color is set once from this thread. */
+void control_daemon::start()
+{
+    if (settings_.mode == animation_mode::solid) {
+        for (auto& anim : anims_)
+            anim->run();
+        return;
+    }
+
+    bool report_stats = settings_.report_stats && settings_.mode != animation_mode::screen_zones;
+    auto play = [report_stats](animation_base* anim) {
+        anim->resume();
+        return std::thread([anim, report_stats] {
+            while (!anim->stopped()) {
+                anim->run();
+                if (report_stats) anim->frame_timing().print(std::cerr);
+            }
+        });
+    };
+    if (settings_.mode == animation_mode::screen_zones) {
+        threads_.push_back(play(screen_.get()));
+        return;
+    }
+    for (auto& anim : anims_)
+        threads_.push_back(play(anim.get()));
+}
+
+void control_daemon::show(animation_mode mode)
+{
+    /** everything that may be slow or fail happens while the current animation keeps running */
+    std::vector<std::unique_ptr<animation_base>> next;
+    for (hid_device_wrapper* device : devices_) {
+        switch (mode) {
+            case animation_mode::solid:
+                next.push_back(std::make_unique<solid_animation>(*device, settings_.base_color, std::chrono::milliseconds(0)));
+                break;
+            case animation_mode::breathing: next.push_back(std::make_unique<breathing_animation>(*device, settings_.base_color)); break;
+            case animation_mode::wave: next.push_back(std::make_unique<wave_animation>(*device, settings_.base_color)); break;
+            case animation_mode::rainbow: next.push_back(std::make_unique<rainbow_animation>(*device)); break;
+            case animation_mode::screen_zones: break;
+        }
+        if (!next.empty()) configure(*next.back());
+    }
+    if (mode == animation_mode::screen_zones) screen();
+
+    stop();
+    anims_ = std::move(next);
+    settings_.mode = mode;
+    start();
+}
+
+std::string control_daemon::set_zones(const std::string& arguments)
+{
+    int bottom, left, top, right, strip = -1;
+    int parsed = std::sscanf(arguments.c_str(), "%d,%d,%d,%d %d", &bottom, &left, &top, &right, &strip);
+    if (parsed < 4 || bottom < 1 || left < 1 || top < 1 || right < 1) return "error: use zones bottom,left,top,right [strip]";
+    if (parsed == 5 && (strip < 0 || static_cast<size_t>(strip) >= devices_.size())) return "error: no strip " + std::to_string(strip);
+
+    /** strips keep their monitors, only the zone counts change */
+    std::vector<zone_layout> layouts;
+    for (size_t i = 0; i < devices_.size(); ++i) {
+        layouts.push_back(layout_of(i));
+        if (parsed == 5 && static_cast<size_t>(strip) != i) continue;
+        layouts.back().bottom_zones = static_cast<size_t>(bottom);
+        layouts.back().left_zones = static_cast<size_t>(left);
+        layouts.back().top_zones = static_cast<size_t>(top);
+        layouts.back().right_zones = static_cast<size_t>(right);
+    }
+    settings_.layouts = std::move(layouts);
+
+    if (screen_) {
+        bool running = settings_.mode == animation_mode::screen_zones;
+        if (running) stop();
+        for (size_t i = 0; i < devices_.size(); ++i)
+            screen_->set_layout(*devices_[i], layout_of(i));
+        if (running) start();
+    }
+    return "ok";
+}
+
+std::string control_daemon::set_fps(const std::string& arguments)
+{
+    int fps = 0, output_fps = 0;
+    int parsed = std::sscanf(arguments.c_str(), "%d %d", &fps, &output_fps);
+    if (parsed < 1 || fps < 1 || fps > 1000 || output_fps < 0 || output_fps > 1000) return "error: use fps capture [output] (1-1000, output 0-1000)";
+
+    settings_.screen.fps = static_cast<size_t>(fps);
+    settings_.screen.output_fps = static_cast<size_t>(output_fps);
+    if (screen_) {
+        bool running = settings_.mode == animation_mode::screen_zones;
+        if (running) stop();
+        screen_->set_rate(settings_.screen.fps, settings_.screen.output_fps);
+        if (running) start();
+    }
+    return "ok";
+}
+
+std::string control_daemon::status() const
+{
+    std::ostringstream out;
+    const auto& c = settings_.base_color;
+    out << "ok mode " << mode_name(settings_.mode) << " color " << static_cast<int>(c.r) << ',' << static_cast<int>(c.g) << ',' << static_cast<int>(c.b) << " fps "
+        << settings_.screen.fps << ' ' << settings_.screen.output_fps << " strips " << devices_.size() << " zones";
+    for (size_t i = 0; i < devices_.size(); ++i) {
+        auto l = layout_of(i);
+        out << ' ' << l.bottom_zones << ',' << l.left_zones << ',' << l.top_zones << ',' << l.right_zones;
+    }
+    return out.str();
+}
+
+std::string control_daemon::execute(std::string_view command)
+{
+    std::string line(command);
+    size_t split = line.find(' ');
+    std::string name = line.substr(0, split);
+    std::string arguments = split == std::string::npos ? std::string() : line.substr(split + 1);
+
+    try {
+        if (name == "mode") {
+            for (auto mode : { animation_mode::solid, animation_mode::breathing, animation_mode::wave, animation_mode::rainbow, animation_mode::screen_zones }) {
+                if (arguments != mode_name(mode)) continue;
+                show(mode);
+                return "ok";
+            }
+            return "error: unknown mode '" + arguments + "'";
+        }
+        if (name == "color") {
+            int r, g, b;
+            if (std::sscanf(arguments.c_str(), "%d,%d,%d", &r, &g, &b) != 3 || r < 0 || r > 255 || g < 0 || g > 255 || b < 0 || b > 255) {
+                return "error: use color r,g,b (0-255)";
+            }
+            settings_.base_color = { static_cast<uint8_t>(r), static_cast<uint8_t>(g), static_cast<uint8_t>(b) };
+            /** modes without a base color keep running undisturbed */
+            if (settings_.mode == animation_mode::solid || settings_.mode == animation_mode::breathing || settings_.mode == animation_mode::wave) show(settings_.mode);
+            return "ok";
+        }
+        if (name == "zones") return set_zones(arguments);
+        if (name == "fps") return set_fps(arguments);
+        if (name == "status") return status();
+        if (name == "quit") {
+            finished_ = true;
+            return "ok";
+        }
+        return "error: unknown command '" + name + "'";
+    } catch (const std::exception& e) {
+        return std::string("error: ") + e.what();
+    }
+}
+
+} // namespace led
@@ -0,0 +1,175 @@
+#include "control_server.hpp"
+#include <stdexcept>
+
+#if defined(_WIN32) || defined(_WIN64)
+
+namespace led
+{
+
+control_server::control_server(std::string path) : path_(std::move(path))
+{
+    throw std::runtime_error("The control socket needs Unix domain sockets, which this platform does not provide");
+}
+
+control_server::~control_server() = default;
+
+void control_server::close_client(size_t)
+{
+}
+
+void control_server::poll(std::chrono::milliseconds, const handler&)
+{
+}
+
+std::string send_control_command(const std::string&, std::string_view)
+{
+    throw std::runtime_error("The control socket needs Unix domain sockets, which this platform does not provide");
+}
+
+} // namespace led
+
+#else
+
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace led
+{
+
+static sockaddr_un socket_address(const std::string& path)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) throw std::runtime_error("Invalid control socket path: " + path);
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+static int connect_socket(const sockaddr_un& address)
+{
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+control_server::control_server(std::string path) : path_(std::move(path))
+{
+    sockaddr_un address = socket_address(path_);
+
+    /** a socket file nobody answers on is left over from a daemon that did not exit cleanly */
+    if (int fd = connect_socket(address); fd >= 0) {
+        ::close(fd);
+        throw std::runtime_error("Another daemon is already listening on " + path_);
+    }
+    /** only a stale socket is removed, a mistyped path must not delete someone's file */
+    struct stat status;
+    if (::lstat(path_.c_str(), &status) == 0) {
+        if (!S_ISSOCK(status.st_mode)) throw std::runtime_error("Control socket path " + path_ + " exists and is not a socket");
+        ::unlink(path_.c_str());
+    }
+
+    listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) throw std::runtime_error("Failed to create control socket: " + std::string(std::strerror(errno)));
+
+    mode_t mask = ::umask(0077);
+    int bound = ::bind(listen_fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+    ::umask(mask);
+    if (bound != 0 || ::listen(listen_fd_, 8) != 0) {
+        std::string error = std::strerror(errno);
+        ::close(listen_fd_);
+        throw std::runtime_error("Failed to listen on " + path_ + ": " + error);
+    }
+}
+
+control_server::~control_server()
+{
+    for (auto& c : clients_)
+        ::close(c.fd);
+    ::close(listen_fd_);
+    ::unlink(path_.c_str());
+}
+
+void control_server::close_client(size_t index)
+{
+    ::close(clients_[index].fd);
+    clients_.erase(clients_.begin() + index);
+}
+
+void control_server::poll(std::chrono::milliseconds timeout, const handler& handle)
+{
+    std::vector<pollfd> fds;
+    fds.reserve(clients_.size() + 1);
+    fds.push_back({ listen_fd_, POLLIN, 0 });
+    for (const auto& c : clients_)
+        fds.push_back({ c.fd, POLLIN, 0 });
+
+    int ready = ::poll(fds.data(), fds.size(), static_cast<int>(timeout.count()));
+    if (ready <= 0) return;
+
+    /** clients are visited back to front, so closing one does not shift the ones still to do */
+    for (size_t i = fds.size() - 1; i > 0; --i) {
+        if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+
+        size_t index = i - 1;
+        char buffer[256];
+        ssize_t received = ::recv(clients_[index].fd, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            close_client(index);
+            continue;
+        }
+
+        auto& pending = clients_[index].pending;
+        pending.append(buffer, static_cast<size_t>(received));
+        bool failed = false;
+        for (size_t end = pending.find('\n'); end != std::string::npos && !failed; end = pending.find('\n')) {
+            std::string command = pending.substr(0, end);
+            pending.erase(0, end + 1);
+            if (!command.empty() && command.back() == '\r') command.pop_back();
+
+            /** a client that stopped reading is dropped rather than blocking the daemon */
+            std::string reply = handle(command) + '\n';
+            failed = ::send(clients_[index].fd, reply.data(), reply.size(), MSG_NOSIGNAL | MSG_DONTWAIT) != static_cast<ssize_t>(reply.size());
+        }
+        if (failed || pending.size() > k_max_line) close_client(index);
+    }
+
+    if (fds[0].revents & POLLIN) {
+        int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd >= 0) clients_.push_back({ fd, {} });
+    }
+}
+
+std::string send_control_command(const std::string& path, std::string_view command)
+{
+    int fd = connect_socket(socket_address(path));
+    if (fd < 0) throw std::runtime_error("No daemon is listening on " + path);
+
+    std::string line(command);
+    line += '\n';
+    std::string reply;
+    if (::send(fd, line.data(), line.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(line.size())) {
+        char buffer[256];
+        while (reply.find('\n') == std::string::npos) {
+            ssize_t received = ::recv(fd, buffer, sizeof(buffer), 0);
+            if (received <= 0) break;
+            reply.append(buffer, static_cast<size_t>(received));
+        }
+    }
+    ::close(fd);
+
+    if (reply.empty()) throw std::runtime_error("The daemon on " + path + " did not answer");
+    return reply.substr(0, reply.find('\n'));
+}
+
+} // namespace led
+
+#endif
@@ -0,0 +1,52 @@
+#include "cpu_features.hpp"
+
+#if defined(NLCTL_X86) && defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+#ifdef NLCTL_X86
+
+bool cpu_has_sse2()
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_cpu_supports("sse2");
+#else
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#endif
+}
+
+bool cpu_has_avx2()
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_cpu_supports("avx2");
+#else
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+
+    /** the OS must also save the YMM registers on context switch */
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!osxsave || (_xgetbv(0) & 0x6) != 0x6) return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#endif
+}
+
+#else
+
+bool cpu_has_sse2()
+{
+    return false;
+}
+
+bool cpu_has_avx2()
+{
+    return false;
+}
+
+#endif
@@ -1,117 +1,257 @@
 #include "hid_device.hpp"
-#include <hidapi.h>
+#include "metrics.hpp"
 #include <algorithm>
 #include <chrono>
 #include <cstring>
 #include <stdexcept>
 #include <thread>
+#include <utility>
 #include <array>
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 
 namespace led
 {
 
 /**
- * Open the device from the vendor ID and product ID.
+ * Location of the per-serial cache file, empty if there is no usable cache directory.
  */
-hid_device_wrapper::hid_device_wrapper(uint16_t vid, uint16_t pid) : device_(hid_open(vid, pid, nullptr)), zone_count_(0)
+static std::filesystem::path cache_path(const std::string& serial)
 {
-    if (!device_) {
-        throw std::runtime_error("Failed to open HID device");
+    if (serial.empty()) return {};
+
+#if defined(_WIN32) || defined(_WIN64)
+    const char* base = std::getenv("LOCALAPPDATA");
+    if (!base) return {};
+    std::filesystem::path dir(base);
+#else
+    std::filesystem::path dir;
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME")) {
+        dir = xdg;
+    } else if (const char* home = std::getenv("HOME")) {
+        dir = std::filesystem::path(home) / ".cache";
+    } else {
+        return {};
+    }
+#endif
+
+    std::string name;
+    for (char c : serial)
+        name.push_back(std::isalnum(static_cast<unsigned char>(c)) ? c : '_');
+    return dir / "nlctl" / name;
+}
+
+bool hid_device_wrapper::load_cached()
+{
+    auto path = cache_path(descriptor_.serial);
+    if (path.empty()) return false;
+
+    std::ifstream in(path);
+    std::string key;
+    size_t zones = 0;
+    while (in >> key) {
+        if (key == "zone_count") {
+            in >> zones;
+        } else if (key == "manufacturer" || key == "product") {
+            std::string value;
+            std::getline(in, value);
+            if (!value.empty() && value[0] == ' ') value.erase(0, 1);
+            if (descriptor_.manufacturer.empty() && key == "manufacturer") descriptor_.manufacturer = value;
+            if (descriptor_.product.empty() && key == "product") descriptor_.product = value;
+        } else if (key == "release") {
+            in >> descriptor_.release;
+        }
     }
-    /** use non blocking IO */
-    hid_set_nonblocking(device_, 1);
-    zone_count_ = query_zone_count();
+
+    if (zones == 0) return false;
+    zone_count_ = zones;
+    return true;
+}
+
+void hid_device_wrapper::store_cached() const
+{
+    auto path = cache_path(descriptor_.serial);
+    if (path.empty()) return;
+
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    std::ofstream out(path, std::ios::trunc);
+    out << "zone_count " << zone_count_ << '\n';
+    out << "release " << descriptor_.release << '\n';
+    out << "manufacturer " << descriptor_.manufacturer << '\n';
+    out << "product " << descriptor_.product << '\n';
+}
+
+/**
+ * Open the first device matching the vendor ID and product ID.
+ */
+hid_device_wrapper::hid_device_wrapper(uint16_t vid, uint16_t pid, bool use_cache, strip_format format)
+    : hid_device_wrapper(open_hidapi_transport(vid, pid), use_cache, std::move(format))
+{
+}
+
+/**
+ * The zone count is taken from the per-serial cache when possible, so only the first run ever
+ * waits on the 0x03 query.
+ */
+hid_device_wrapper::hid_device_wrapper(std::unique_ptr<hid_transport> transport, bool use_cache, strip_format format)
+    : transport_(std::move(transport)), zone_count_(0), descriptor_(transport_->descriptor()), reports_(std::move(format))
+{
+    if (!use_cache || !load_cached()) {
+        zone_count_ = query_zone_count();
+        if (zone_count_ > 0) store_cached();
+    }
+    writer_ = std::thread([this] { writer_loop(); });
 }
 
 hid_device_wrapper::~hid_device_wrapper()
 {
-    if (device_) {
-        hid_close(device_);
-        hid_exit();
+    /** the writer drains the mailbox before it exits, so a final frame is never lost */
+    {
+        std::lock_guard<std::mutex> lock(mailbox_mutex_);
+        stop_ = true;
     }
+    mailbox_cv_.notify_one();
+    if (writer_.joinable()) writer_.join();
 }
 
-void hid_device_wrapper::send_command(uint8_t cmd, const uint8_t* data, size_t data_len, uint8_t* response)
+bool hid_device_wrapper::send_command(uint8_t cmd, const uint8_t* data, size_t data_len, uint8_t* response)
 {
+    hid_command command{ cmd, data, data_len, response };
+    return send_commands(&command, 1);
+}
+
+/**
+ * Writes every command back to back, then collects one response per command in the order they
+ * were sent, all within a single deadline. Returns false if a payload does not fit a report, a
+ * write fails, or a response is late or answers a different command.
+ */
+bool hid_device_wrapper::send_commands(const hid_command* commands, size_t count, std::chrono::milliseconds timeout)
+{
+    /** a clamped payload would go out under a header announcing the full length */
+    for (size_t i = 0; i < count; ++i) {
+        if (commands[i].data_len > k_buffer_size - 4) return false;
+    }
+
     std::array<uint8_t, k_buffer_size> buffer{};
-    buffer[1] = cmd;
-    buffer[2] = (data_len >> 8) & 0xFF;
-    buffer[3] = data_len & 0xFF;
+    std::lock_guard<std::mutex> lock(io_mutex_);
 
-    if (data) {
-        std::memcpy(&buffer[4], data, data_len);
+    /** drop unsolicited reports so the responses line up with their commands */
+    while (transport_->read_timeout(buffer.data(), k_read_size, 0) > 0) {
     }
 
-    hid_write(device_, buffer.data(), buffer.size());
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    for (size_t i = 0; i < count; ++i) {
+        const auto& c = commands[i];
+        buffer.fill(0);
+        buffer[1] = c.cmd;
+        buffer[2] = (c.data_len >> 8) & 0xFF;
+        buffer[3] = c.data_len & 0xFF;
 
-    int result = hid_read(device_, buffer.data(), k_read_size);
-    if (response && result > 0) {
-        std::memcpy(response, buffer.data(), k_read_size);
+        if (c.data) {
+            std::memcpy(&buffer[4], c.data, c.data_len);
+        }
+        if (transport_->write(buffer.data(), buffer.size()) < 0) return false;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    for (size_t i = 0; i < count; ++i) {
+        int result = 0;
+        while (result == 0) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (remaining.count() <= 0) return false;
+            result = transport_->read_timeout(buffer.data(), k_read_size, static_cast<int>(remaining.count()));
+        }
+        /** responses echo their command at byte 1 */
+        if (result < 0 || buffer[1] != commands[i].cmd) return false;
+
+        if (commands[i].response) {
+            std::memcpy(commands[i].response, buffer.data(), k_read_size);
+        }
+    }
+    return true;
+}
+
+void hid_device_wrapper::set_colors(std::span<const color> colors)
+{
+    hot_path().frames.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(mailbox_mutex_);
+        if (mailbox_full_) stats_.dropped.fetch_add(1, std::memory_order_relaxed);
+        mailbox_.assign(colors.begin(), colors.end());
+        mailbox_full_ = true;
     }
+    mailbox_cv_.notify_one();
 }
 
-void hid_device_wrapper::set_colors(const std::vector<color>& colors)
+void hid_device_wrapper::writer_loop()
 {
-    std::vector<uint8_t> rgb_data(colors.size() * 3);
+    std::vector<color> frame;
 
-    for (size_t i = 0; i < colors.size(); ++i) {
-        const auto& c = colors[i];
-        // Zones 0-19 use GRB, 20+ use RBG
-        if (i < 20) {
-            rgb_data[i * 3] = c.g;
-            rgb_data[i * 3 + 1] = c.r;
-            rgb_data[i * 3 + 2] = c.b;
-        } else {
-            rgb_data[i * 3] = c.r;
-            rgb_data[i * 3 + 1] = c.b;
-            rgb_data[i * 3 + 2] = c.g;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mailbox_mutex_);
+            mailbox_cv_.wait(lock, [this] { return mailbox_full_ || stop_; });
+            if (!mailbox_full_) return;
+            frame.swap(mailbox_);
+            mailbox_full_ = false;
+        }
+
+        if (!changed_enough(frame)) {
+            stats_.suppressed.fetch_add(1, std::memory_order_relaxed);
+            continue;
         }
+
+        auto start = std::chrono::steady_clock::now();
+        write_colors(frame);
+        auto busy = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        last_sent_ = frame;
+        stats_.busy_ns.fetch_add(static_cast<uint64_t>(busy.count()), std::memory_order_relaxed);
+        stats_.sent.fetch_add(1, std::memory_order_relaxed);
     }
+}
 
-    write_rgb_data(rgb_data);
+bool hid_device_wrapper::changed_enough(const std::vector<color>& colors) const
+{
+    if (colors.size() != last_sent_.size()) return true;
+
+    int threshold = change_threshold_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < colors.size(); ++i) {
+        const auto& a = colors[i];
+        const auto& b = last_sent_[i];
+        int delta = std::max({ std::abs(a.r - b.r), std::abs(a.g - b.g), std::abs(a.b - b.b) });
+        if (delta >= threshold) return true;
+    }
+    return false;
+}
+
+void hid_device_wrapper::write_colors(const std::vector<color>& colors)
+{
+    auto& metrics = hot_path();
+    {
+        scoped_timer timer(metrics.pack);
+        reports_.encode(colors);
+    }
+
+    std::lock_guard<std::mutex> lock(io_mutex_);
+    for (size_t i = 0; i < reports_.report_count(); ++i)
+        timed(metrics.hid_write, [&] { return transport_->write(reports_.report(i), k_buffer_size); });
 }
 
-void hid_device_wrapper::initialize()
+bool hid_device_wrapper::initialize()
 {
     uint8_t on = 1;
     uint8_t brightness = 255;
-    send_command(0x07, &on, 1);
-    send_command(0x09, &brightness, 1);
+    hid_command commands[] = { { 0x07, &on, 1, nullptr }, { 0x09, &brightness, 1, nullptr } };
+    return send_commands(commands, 2);
 }
 
 size_t hid_device_wrapper::query_zone_count()
 {
     std::array<uint8_t, k_read_size> response{};
-    send_command(0x03, nullptr, 0, response.data());
+    if (!send_command(0x03, nullptr, 0, response.data())) return 0;
     return response[4];
 }
 
-void hid_device_wrapper::write_rgb_data(const std::vector<uint8_t>& rgb_data)
-{
-    std::array<uint8_t, k_buffer_size> buffer{};
-    size_t len = rgb_data.size();
-
-    // First packet
-    buffer[1] = 0x02;
-    buffer[2] = (len >> 8) & 0xFF;
-    buffer[3] = len & 0xFF;
-    std::memcpy(&buffer[4], rgb_data.data(), std::min(size_t(60), rgb_data.size()));
-    hid_write(device_, buffer.data(), buffer.size());
-
-    // Second packet
-    buffer.fill(0);
-    if (rgb_data.size() > 60) {
-        std::memcpy(&buffer[1], &rgb_data[60], std::min(size_t(64), rgb_data.size() - 60));
-    }
-    hid_write(device_, buffer.data(), buffer.size());
-
-    // Third packet
-    buffer.fill(0);
-    if (rgb_data.size() > 124) {
-        std::memcpy(&buffer[1], &rgb_data[124], std::min(size_t(38), rgb_data.size() - 124));
-    }
-    hid_write(device_, buffer.data(), buffer.size());
-}
-
 } // namespace led
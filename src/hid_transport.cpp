@@ -0,0 +1,103 @@
+#include "hid_transport.hpp"
+#include <algorithm>
+#include <hidapi.h>
+#include <mutex>
+#include <stdexcept>
+
+namespace led
+{
+
+static std::string narrow(const wchar_t* text)
+{
+    std::string out;
+    for (; text && *text; ++text)
+        out.push_back(*text < 0x80 ? static_cast<char>(*text) : '?');
+    return out;
+}
+
+/** hidapi is shut down with the last open transport, not the first one closed */
+static std::mutex g_library_mutex;
+static size_t g_open_transports = 0;
+
+class hidapi_transport : public hid_transport
+{
+    hid_device* device_;
+    device_descriptor descriptor_;
+
+  public:
+    hidapi_transport(hid_device* device, device_descriptor descriptor) : device_(device), descriptor_(std::move(descriptor))
+    {
+        /** use non blocking IO */
+        hid_set_nonblocking(device_, 1);
+        std::lock_guard<std::mutex> lock(g_library_mutex);
+        ++g_open_transports;
+    }
+
+    ~hidapi_transport() override
+    {
+        hid_close(device_);
+        std::lock_guard<std::mutex> lock(g_library_mutex);
+        if (--g_open_transports == 0) hid_exit();
+    }
+
+    int write(const uint8_t* data, size_t length) override
+    {
+        return hid_write(device_, data, length);
+    }
+
+    int read_timeout(uint8_t* data, size_t length, int milliseconds) override
+    {
+        return hid_read_timeout(device_, data, length, milliseconds);
+    }
+
+    const device_descriptor& descriptor() const override
+    {
+        return descriptor_;
+    }
+};
+
+static device_descriptor describe(const hid_device_info* info)
+{
+    device_descriptor descriptor;
+    descriptor.serial = narrow(info->serial_number);
+    descriptor.manufacturer = narrow(info->manufacturer_string);
+    descriptor.product = narrow(info->product_string);
+    descriptor.release = info->release_number;
+    return descriptor;
+}
+
+std::unique_ptr<hid_transport> open_hidapi_transport(uint16_t vid, uint16_t pid)
+{
+    hid_device* device = nullptr;
+    device_descriptor descriptor;
+
+    hid_device_info* devices = hid_enumerate(vid, pid);
+    if (devices) {
+        descriptor = describe(devices);
+        device = hid_open_path(devices->path);
+        hid_free_enumeration(devices);
+    }
+
+    if (!device) {
+        throw std::runtime_error("Failed to open HID device");
+    }
+    return std::make_unique<hidapi_transport>(device, std::move(descriptor));
+}
+
+std::vector<std::unique_ptr<hid_transport>> open_hidapi_transports(uint16_t vid, uint16_t pid)
+{
+    std::vector<std::unique_ptr<hid_transport>> transports;
+
+    hid_device_info* devices = hid_enumerate(vid, pid);
+    for (hid_device_info* info = devices; info; info = info->next) {
+        if (hid_device* device = hid_open_path(info->path)) {
+            transports.push_back(std::make_unique<hidapi_transport>(device, describe(info)));
+        }
+    }
+    hid_free_enumeration(devices);
+
+    std::sort(transports.begin(), transports.end(), [](const auto& a, const auto& b) { return a->descriptor().serial < b->descriptor().serial; });
+    return transports;
+}
+
+} // namespace led
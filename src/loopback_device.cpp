@@ -0,0 +1,138 @@
+#include "loopback_device.hpp"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <utility>
+
+namespace led
+{
+
+loopback_device::loopback_device(size_t zone_count, std::chrono::microseconds write_latency, strip_format format)
+    : zone_count_(std::min<size_t>(zone_count, 255)), write_latency_(write_latency), format_(std::move(format))
+{
+    descriptor_.serial = "LOOPBACK";
+    descriptor_.manufacturer = "nlctl";
+    descriptor_.product = "Loopback LED strip";
+}
+
+/**
+ * Responses mirror the command framing: command byte at 1, payload length at 2-3, payload from 4.
+ */
+void loopback_device::respond(uint8_t cmd, uint8_t value)
+{
+    std::array<uint8_t, k_report_size> report{};
+    report[1] = cmd;
+    report[3] = 1;
+    report[4] = value;
+    responses_.push_back(report);
+    response_cv_.notify_one();
+}
+
+void loopback_device::decode_frame()
+{
+    size_t zones = std::min(zone_count_, rgb_.size() / 3);
+    frame_.resize(zones);
+
+    for (size_t i = 0; i < zones; ++i) {
+        const uint8_t* p = &rgb_[i * 3];
+        channel_order order = report_encoder::order_of(format_, i);
+        frame_[i] = { p[order.r], p[order.g], p[order.b] };
+    }
+    frames_++;
+}
+
+int loopback_device::write(const uint8_t* data, size_t length)
+{
+    if (write_latency_.count() > 0) std::this_thread::sleep_for(write_latency_);
+    if (length < 2) return -1;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    reports_++;
+
+    /** data[0] is the report ID */
+    const uint8_t* payload = data + 1;
+    size_t payload_len = length - 1;
+
+    if (packets_left_ > 0) {
+        /** every continuation report carries up to next_payload color bytes, padding reports none */
+        size_t take = std::min({ payload_len, format_.next_payload, expected_ - std::min(expected_, rgb_.size()) });
+        rgb_.insert(rgb_.end(), payload, payload + take);
+        if (--packets_left_ == 0) decode_frame();
+        return static_cast<int>(length);
+    }
+
+    if (payload_len < 3) return static_cast<int>(length);
+    uint8_t cmd = payload[0];
+    size_t data_len = (static_cast<size_t>(payload[1]) << 8) | payload[2];
+    const uint8_t* body = payload + 3;
+    size_t body_len = payload_len - 3;
+
+    switch (cmd) {
+        case 0x02:
+            expected_ = data_len;
+            rgb_.clear();
+            rgb_.insert(rgb_.end(), body, body + std::min({ body_len, data_len, format_.first_payload }));
+            packets_left_ = report_encoder::reports_for(format_, data_len) - 1;
+            if (packets_left_ == 0) decode_frame();
+            break;
+        case 0x03:
+            respond(cmd, static_cast<uint8_t>(zone_count_));
+            break;
+        case 0x07:
+            powered_ = body_len > 0 && body[0] != 0;
+            respond(cmd, powered_ ? 1 : 0);
+            break;
+        case 0x09:
+            brightness_ = body_len > 0 ? body[0] : 0;
+            respond(cmd, brightness_);
+            break;
+        default:
+            break;
+    }
+    return static_cast<int>(length);
+}
+
+int loopback_device::read_timeout(uint8_t* data, size_t length, int milliseconds)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!response_cv_.wait_for(lock, std::chrono::milliseconds(std::max(0, milliseconds)), [this] { return !responses_.empty(); })) {
+        return 0;
+    }
+
+    size_t n = std::min(length, k_report_size);
+    std::memcpy(data, responses_.front().data(), n);
+    responses_.pop_front();
+    return static_cast<int>(n);
+}
+
+uint64_t loopback_device::frames() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return frames_;
+}
+
+uint64_t loopback_device::reports() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return reports_;
+}
+
+std::vector<color> loopback_device::last_frame() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return frame_;
+}
+
+bool loopback_device::powered() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return powered_;
+}
+
+uint8_t loopback_device::brightness() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return brightness_;
+}
+
+} // namespace led
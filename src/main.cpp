@@ -1,27 +1,108 @@
 #include "animations.hpp"
+#include "control_daemon.hpp"
+#include "control_server.hpp"
 #include "hid_device.hpp"
+#include "loopback_device.hpp"
+#include "metrics.hpp"
+#include <algorithm>
+#include <chrono>
 #include <cstring>
 #include <iostream>
 #include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 #include <iostream>
 #include <cstring>
 
-enum class mode
+/**
+ * Runs one animation per strip, each on its own thread, until the process is stopped.
+ */
+static void run_forever(std::vector<std::unique_ptr<led::animation_base>>& anims, bool report_stats)
 {
-    solid,
-    breathing,
-    wave,
-    rainbow,
-    screen_zones
+    std::vector<std::thread> threads;
+    for (auto& anim : anims) {
+        threads.emplace_back([&anim, report_stats] {
+            while (true) {
+                anim->run();
+                if (report_stats) anim->frame_timing().print(std::cerr);
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+}
+
+/** One --layer argument: what to render and how it is stacked onto the layers before it. */
+struct layer_spec
+{
+    std::string source;
+    led::blend_mode mode = led::blend_mode::alpha;
+    uint32_t opacity = led::k_opaque;
 };
 
+/** Parses `source[:blend[:opacity%]]`, e.g. "breathing:multiply" or "rainbow:alpha:30". */
+static bool parse_layer(const std::string& text, layer_spec& spec)
+{
+    size_t split = text.find(':');
+    spec.source = text.substr(0, split);
+    if (spec.source != "solid" && spec.source != "breathing" && spec.source != "wave" && spec.source != "rainbow" && spec.source != "reactive") return false;
+    if (split == std::string::npos) return true;
+
+    std::string rest = text.substr(split + 1);
+    split = rest.find(':');
+    std::string blend = rest.substr(0, split);
+    if (blend == "alpha") {
+        spec.mode = led::blend_mode::alpha;
+    } else if (blend == "add") {
+        spec.mode = led::blend_mode::add;
+    } else if (blend == "multiply") {
+        spec.mode = led::blend_mode::multiply;
+    } else if (blend == "max") {
+        spec.mode = led::blend_mode::max;
+    } else {
+        return false;
+    }
+    if (split == std::string::npos) return true;
+
+    double percent = 0.0;
+    if (std::sscanf(rest.c_str() + split + 1, "%lf", &percent) != 1 || percent < 0.0 || percent > 100.0) return false;
+    spec.opacity = led::brightness_level(percent / 100.0);
+    return true;
+}
+
 int main(int argc, char* argv[])
 {
     try {
-        int bottom_zones = 10, left_zones = 10, top_zones = 10, right_zones = 10;
+        /** one layout and one monitor per strip in serial number order, the last one repeats for any further strips */
+        std::vector<led::zone_layout> layouts;
+        std::vector<std::string> monitors;
+        int sample_stride = 1;
+        bool border_capture = true;
+        bool track_damage = true;
+        bool pipelined = false;
+        bool report_stats = false;
+        int change_threshold = 1;
+        bool use_cache = true;
+        std::vector<int> loopback_zones;
+        std::vector<layer_spec> layers;
+        const char* metrics_file = nullptr;
+        const char* daemon_socket = nullptr;
+        const char* send_socket = nullptr;
+        const char* send_command = nullptr;
+        const char* source = "";
+        int analysis_threads = 1;
+        int fps = 60;
+        int output_fps = 0;
+        double cpu_budget = 0.0;
+        double metrics_interval = 5.0;
+        double gamma = 1.0;
+        bool dither = false;
+        led::overrun_policy overrun = led::overrun_policy::skip;
 
         led::color clr{ 255, 255, 255 };
-        mode run_mode = mode::solid;
+        led::animation_mode run_mode = led::animation_mode::solid;
 
         for (int i = 1; i < argc; ++i) {
             if (std::strcmp(argv[i], "--color") == 0 && i + 1 < argc) {
@@ -32,68 +113,288 @@ int main(int argc, char* argv[])
                 }
                 clr = { static_cast<uint8_t>(r), static_cast<uint8_t>(g), static_cast<uint8_t>(b) };
             } else if (std::strcmp(argv[i], "--zones") == 0 && i + 1 < argc) {
-                if (std::sscanf(argv[++i], "%d,%d,%d,%d", &bottom_zones, &left_zones, &top_zones, &right_zones) != 4) {
+                int bottom, left, top, right;
+                if (std::sscanf(argv[++i], "%d,%d,%d,%d", &bottom, &left, &top, &right) != 4 || bottom < 1 || left < 1 || top < 1 || right < 1) {
                     std::cerr << "Invalid zones format. Use: --zones bottom,left,top,right\n";
                     return 1;
                 }
+                layouts.push_back({ static_cast<size_t>(bottom), static_cast<size_t>(left), static_cast<size_t>(top), static_cast<size_t>(right), {} });
+            } else if (std::strcmp(argv[i], "--sample-stride") == 0 && i + 1 < argc) {
+                if (std::sscanf(argv[++i], "%d", &sample_stride) != 1 || sample_stride < 1) {
+                    std::cerr << "Invalid sample stride. Use: --sample-stride n (n >= 1)\n";
+                    return 1;
+                }
+            } else if (std::strcmp(argv[i], "--full-capture") == 0) {
+                border_capture = false;
+            } else if (std::strcmp(argv[i], "--no-damage") == 0) {
+                track_damage = false;
+            } else if (std::strcmp(argv[i], "--pipeline") == 0) {
+                pipelined = true;
+            } else if (std::strcmp(argv[i], "--stats") == 0) {
+                report_stats = true;
+            } else if (std::strcmp(argv[i], "--change-threshold") == 0 && i + 1 < argc) {
+                if (std::sscanf(argv[++i], "%d", &change_threshold) != 1 || change_threshold < 0 || change_threshold > 255) {
+                    std::cerr << "Invalid change threshold. Use: --change-threshold n (0-255)\n";
+                    return 1;
+                }
+            } else if (std::strcmp(argv[i], "--gamma") == 0 && i + 1 < argc) {
+                if (std::sscanf(argv[++i], "%lf", &gamma) != 1 || gamma <= 0.0) {
+                    std::cerr << "Invalid gamma. Use: --gamma g (g > 0)\n";
+                    return 1;
+                }
+            } else if (std::strcmp(argv[i], "--dither") == 0) {
+                dither = true;
+            } else if (std::strcmp(argv[i], "--catch-up") == 0) {
+                overrun = led::overrun_policy::catch_up;
+            } else if (std::strcmp(argv[i], "--loopback") == 0 && i + 1 < argc) {
+                int zones = 0;
+                if (std::sscanf(argv[++i], "%d", &zones) != 1 || zones < 1 || zones > 255) {
+                    std::cerr << "Invalid loopback zone count. Use: --loopback n (1-255)\n";
+                    return 1;
+                }
+                loopback_zones.push_back(zones);
+            } else if (std::strcmp(argv[i], "--metrics-file") == 0 && i + 1 < argc) {
+                metrics_file = argv[++i];
+            } else if (std::strcmp(argv[i], "--metrics-interval") == 0 && i + 1 < argc) {
+                if (std::sscanf(argv[++i], "%lf", &metrics_interval) != 1 || metrics_interval <= 0.0) {
+                    std::cerr << "Invalid metrics interval. Use: --metrics-interval seconds\n";
+                    return 1;
+                }
+            } else if (std::strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+                if (std::sscanf(argv[++i], "%d", &fps) != 1 || fps < 1 || fps > 1000) {
+                    std::cerr << "Invalid capture rate. Use: --fps n (1-1000)\n";
+                    return 1;
+                }
+            } else if (std::strcmp(argv[i], "--output-fps") == 0 && i + 1 < argc) {
+                if (std::sscanf(argv[++i], "%d", &output_fps) != 1 || output_fps < 0 || output_fps > 1000) {
+                    std::cerr << "Invalid output rate. Use: --output-fps n (0-1000)\n";
+                    return 1;
+                }
+            } else if (std::strcmp(argv[i], "--cpu-budget") == 0 && i + 1 < argc) {
+                if (std::sscanf(argv[++i], "%lf", &cpu_budget) != 1 || cpu_budget <= 0.0 || cpu_budget > 100.0) {
+                    std::cerr << "Invalid CPU budget. Use: --cpu-budget percent (of one core, e.g. 2)\n";
+                    return 1;
+                }
+            } else if (std::strcmp(argv[i], "--analysis-threads") == 0 && i + 1 < argc) {
+                if (std::sscanf(argv[++i], "%d", &analysis_threads) != 1 || analysis_threads < 1) {
+                    std::cerr << "Invalid analysis thread count. Use: --analysis-threads n (n >= 1)\n";
+                    return 1;
+                }
+            } else if (std::strcmp(argv[i], "--monitor") == 0 && i + 1 < argc) {
+                monitors.emplace_back(argv[++i]);
+            } else if (std::strcmp(argv[i], "--source") == 0 && i + 1 < argc) {
+                source = argv[++i];
+            } else if (std::strcmp(argv[i], "--daemon") == 0 && i + 1 < argc) {
+                daemon_socket = argv[++i];
+            } else if (std::strcmp(argv[i], "--send") == 0 && i + 2 < argc) {
+                send_socket = argv[++i];
+                send_command = argv[++i];
+            } else if (std::strcmp(argv[i], "--layer") == 0 && i + 1 < argc) {
+                layer_spec spec;
+                if (!parse_layer(argv[++i], spec)) {
+                    std::cerr << "Invalid layer. Use: --layer solid|breathing|wave|rainbow|reactive[:alpha|add|multiply|max[:opacity%]]\n";
+                    return 1;
+                }
+                layers.push_back(spec);
+            } else if (std::strcmp(argv[i], "--no-cache") == 0) {
+                use_cache = false;
             } else if (std::strcmp(argv[i], "--breathing") == 0) {
-                run_mode = mode::breathing;
+                run_mode = led::animation_mode::breathing;
             } else if (std::strcmp(argv[i], "--wave") == 0) {
-                run_mode = mode::wave;
+                run_mode = led::animation_mode::wave;
             } else if (std::strcmp(argv[i], "--rainbow") == 0) {
-                run_mode = mode::rainbow;
+                run_mode = led::animation_mode::rainbow;
             } else if (std::strcmp(argv[i], "--reactive") == 0) {
-                run_mode = mode::screen_zones;
+                run_mode = led::animation_mode::screen_zones;
             }
         }
 
-        led::hid_device_wrapper device;
-        std::cout << "Number of LED's in strip: " << device.zone_count() << '\n';
+        if (layouts.empty()) layouts.emplace_back();
+        if (!monitors.empty()) {
+            while (layouts.size() < monitors.size())
+                layouts.push_back(layouts.back());
+            for (size_t i = 0; i < layouts.size(); ++i)
+                layouts[i].monitor = monitors[std::min(i, monitors.size() - 1)];
+        }
+        if (pipelined && !border_capture) {
+            std::cerr << "--pipeline captures border strips and cannot be combined with --full-capture\n";
+            return 1;
+        }
+        /** the daemon switches whole animations per command, it has no layer stacks to switch */
+        if (!layers.empty() && daemon_socket) {
+            std::cerr << "--layer cannot be combined with --daemon\n";
+            return 1;
+        }
+
+        /** a client only talks to the daemon, the strips stay with it */
+        if (send_socket) {
+            std::string reply = led::send_control_command(send_socket, send_command);
+            std::cout << reply << '\n';
+            return reply.rfind("ok", 0) == 0 ? 0 : 1;
+        }
+
+        /** listening first makes a second daemon fail before it re-initializes the strips of the first */
+        std::unique_ptr<led::control_server> server;
+        if (daemon_socket) server = std::make_unique<led::control_server>(daemon_socket);
+
+        /** every matching strip is driven; each --loopback adds an in-memory emulation of the same wire format instead */
+        const led::strip_format format = led::screen_mirror_format();
+        std::vector<std::unique_ptr<led::hid_device_wrapper>> devices;
+        if (!loopback_zones.empty()) {
+            for (int zones : loopback_zones)
+                devices.push_back(std::make_unique<led::hid_device_wrapper>(std::make_unique<led::loopback_device>(zones, std::chrono::microseconds(0), format), false, format));
+        } else {
+            for (auto& transport : led::open_hidapi_transports(led::k_vendor_id, led::k_product_id))
+                devices.push_back(std::make_unique<led::hid_device_wrapper>(std::move(transport), use_cache, format));
+        }
+        if (devices.empty()) throw std::runtime_error("Failed to open HID device");
+
+        for (size_t i = 0; i < devices.size(); ++i) {
+            auto& device = *devices[i];
+            std::cout << "Number of LED's in strip " << i << " (" << device.descriptor().serial << "): " << device.zone_count() << '\n';
+            if (!device.initialize()) std::cerr << "Warning: strip " << i << " did not confirm power on and brightness\n";
+            device.set_change_threshold(static_cast<uint8_t>(change_threshold));
+        }
+        auto layout_of = [&](size_t strip) { return layouts[std::min(strip, layouts.size() - 1)]; };
+
+        std::unique_ptr<led::metrics_exporter> exporter;
+        if (metrics_file) {
+            exporter = std::make_unique<led::metrics_exporter>(metrics_file, std::chrono::milliseconds(static_cast<int64_t>(metrics_interval * 1000)));
+        }
+
+        led::screen_zone_settings settings;
+        settings.capture_percent = 0.9f;
+        settings.zone_depth = 10;
+        settings.fps = static_cast<size_t>(fps);
+        settings.output_fps = static_cast<size_t>(output_fps);
+        settings.cpu_budget = cpu_budget / 100.0;
+        settings.sample_stride = sample_stride;
+        settings.border_capture = border_capture;
+        settings.track_damage = track_damage;
+        settings.pipelined = pipelined;
+        settings.report_stats = report_stats;
+        settings.source = source;
+        settings.analysis_threads = static_cast<size_t>(analysis_threads);
 
-        device.initialize();
+        if (server) {
+            led::daemon_settings daemon_settings;
+            daemon_settings.mode = run_mode;
+            daemon_settings.base_color = clr;
+            daemon_settings.layouts = layouts;
+            daemon_settings.screen = settings;
+            daemon_settings.gamma = gamma;
+            daemon_settings.dither = dither;
+            daemon_settings.overrun = overrun;
+            daemon_settings.report_stats = report_stats;
 
-        std::unique_ptr<led::animation_base> anim;
+            std::vector<led::hid_device_wrapper*> strips;
+            for (auto& device : devices)
+                strips.push_back(device.get());
+            led::control_daemon daemon(std::move(strips), daemon_settings);
+            std::cout << "Daemon listening on " << daemon_socket << " (send quit to stop)...\n";
+            while (!daemon.finished())
+                server->poll(std::chrono::seconds(1), [&](std::string_view command) { return daemon.execute(command); });
+            return 0;
+        }
+
+        std::vector<std::unique_ptr<led::animation_base>> anims;
+        auto configure = [&](led::animation_base& a) {
+            a.encoder().set_gamma(gamma);
+            a.encoder().set_dither(dither);
+            a.set_overrun_policy(overrun);
+        };
+
+        /** with --layer the effects are stacked bottom to top instead, every strip on one frame loop */
+        if (!layers.empty()) {
+            std::cout << "Running " << layers.size() << " layers (Ctrl+C to stop)...\n";
+            /** one frame loop for every strip, and one capture and analysis for every reactive layer */
+            auto screen = std::make_shared<led::screen_layers>(settings);
+            std::unique_ptr<led::compositor_animation> composite;
+            for (size_t i = 0; i < devices.size(); ++i) {
+                auto& device = *devices[i];
+                size_t zones = device.zone_count();
+                led::compositor stack;
+                for (const auto& spec : layers) {
+                    std::unique_ptr<led::renderer> source;
+                    if (spec.source == "solid") {
+                        source = led::solid_animation::layer(clr);
+                    } else if (spec.source == "breathing") {
+                        source = led::breathing_animation::layer(clr, zones);
+                    } else if (spec.source == "wave") {
+                        source = led::wave_animation::layer(clr, zones);
+                    } else if (spec.source == "rainbow") {
+                        source = led::rainbow_animation::layer(zones);
+                    } else {
+                        source = std::make_unique<led::screen_renderer>(screen, layout_of(i));
+                    }
+                    stack.add_layer(std::move(source), spec.mode, spec.opacity);
+                }
+                if (composite)
+                    composite->add_strip(device, std::move(stack));
+                else
+                    composite = std::make_unique<led::compositor_animation>(device, std::move(stack), static_cast<size_t>(output_fps > 0 ? output_fps : fps));
+            }
+            configure(*composite);
+            anims.push_back(std::move(composite));
+            run_forever(anims, report_stats);
+            return 0;
+        }
 
         switch (run_mode) {
-            case mode::breathing:
+            case led::animation_mode::breathing:
                 std::cout << "Running breathing animation with color (" << static_cast<int>(clr.r) << "," << static_cast<int>(clr.g) << "," << static_cast<int>(clr.b)
                           << ") (Ctrl+C to stop)...\n";
-                anim = std::make_unique<led::breathing_animation>(device, clr);
-                while (true)
-                    anim->run();
+                for (auto& device : devices) {
+                    anims.push_back(std::make_unique<led::breathing_animation>(*device, clr));
+                    configure(*anims.back());
+                }
+                run_forever(anims, report_stats);
                 break;
 
-            case mode::wave:
+            case led::animation_mode::wave:
                 std::cout << "Running wave animation with color (" << static_cast<int>(clr.r) << "," << static_cast<int>(clr.g) << "," << static_cast<int>(clr.b)
                           << ") (Ctrl+C to stop)...\n";
-                anim = std::make_unique<led::wave_animation>(device, clr);
-                while (true)
-                    anim->run();
+                for (auto& device : devices) {
+                    anims.push_back(std::make_unique<led::wave_animation>(*device, clr));
+                    configure(*anims.back());
+                }
+                run_forever(anims, report_stats);
                 break;
 
-            case mode::rainbow:
+            case led::animation_mode::rainbow:
                 std::cout << "Running rainbow animation (Ctrl+C to stop)...\n";
-                anim = std::make_unique<led::rainbow_animation>(device);
-                while (true)
-                    anim->run();
+                for (auto& device : devices) {
+                    anims.push_back(std::make_unique<led::rainbow_animation>(*device));
+                    configure(*anims.back());
+                }
+                run_forever(anims, report_stats);
                 break;
 
-            case mode::solid:
+            case led::animation_mode::solid:
                 std::cout << "Setting solid color (" << static_cast<int>(clr.r) << "," << static_cast<int>(clr.g) << "," << static_cast<int>(clr.b) << ")\n";
-                anim = std::make_unique<led::solid_animation>(device, clr, std::chrono::milliseconds(0));
-                anim->run();
+                for (auto& device : devices) {
+                    led::solid_animation anim(*device, clr, std::chrono::milliseconds(0));
+                    configure(anim);
+                    anim.run();
+                }
                 break;
 
-            case mode::screen_zones:
-                std::cout << "Running screen zone animation with zones (B:" << bottom_zones << " L:" << left_zones << " T:" << top_zones << " R:" << right_zones
-                          << ") (Ctrl+C to stop)...\n";
-                anim = std::make_unique<led::screen_zone_animation>(device, bottom_zones, left_zones, top_zones, right_zones,
-                                                                    0.9f, // 50% screen capture
-                                                                    10,   // 50px zone depth
-                                                                    60);  // 30 fps
+            case led::animation_mode::screen_zones: {
+                for (size_t i = 0; i < devices.size(); ++i) {
+                    const auto l = layout_of(i);
+                    std::cout << "Strip " << i << " zones (B:" << l.bottom_zones << " L:" << l.left_zones << " T:" << l.top_zones << " R:" << l.right_zones << ")";
+                    if (!l.monitor.empty()) std::cout << " on " << l.monitor;
+                    std::cout << '\n';
+                }
+                std::cout << "Running screen zone animation (Ctrl+C to stop)...\n";
+                auto anim = std::make_unique<led::screen_zone_animation>(*devices[0], layout_of(0), settings);
+                for (size_t i = 1; i < devices.size(); ++i)
+                    anim->add_strip(*devices[i], layout_of(i));
+                configure(*anim);
                 while (true)
                     anim->run();
                 break;
+            }
         }
 
         return 0;
@@ -0,0 +1,107 @@
+#include "metrics.hpp"
+#include <bit>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+namespace led
+{
+
+size_t latency_histogram::bucket_of(uint64_t ns)
+{
+    if (ns < k_linear) return static_cast<size_t>(ns);
+
+    size_t exponent = static_cast<size_t>(std::bit_width(ns)) - 1;
+    if (exponent > k_max_exponent) return k_buckets - 1;
+    size_t sub = static_cast<size_t>(ns >> (exponent - k_sub_bits)) & ((size_t(1) << k_sub_bits) - 1);
+    return k_linear + (exponent - 4) * (size_t(1) << k_sub_bits) + sub;
+}
+
+uint64_t latency_histogram::bucket_upper(size_t bucket)
+{
+    if (bucket < k_linear) return bucket + 1;
+
+    size_t offset = bucket - k_linear;
+    size_t exponent = offset / (size_t(1) << k_sub_bits) + 4;
+    uint64_t sub = offset % (size_t(1) << k_sub_bits);
+    return (uint64_t(1) << exponent) + ((sub + 1) << (exponent - k_sub_bits));
+}
+
+uint64_t latency_histogram::percentile_ns(double p) const
+{
+    uint64_t n = count();
+    if (n == 0) return 0;
+
+    uint64_t target = static_cast<uint64_t>(p * (n - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < k_buckets; ++i) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= target) return bucket_upper(i);
+    }
+    return bucket_upper(k_buckets - 1);
+}
+
+hot_path_metrics& hot_path()
+{
+    static hot_path_metrics metrics;
+    return metrics;
+}
+
+void write_prometheus(std::ostream& out, const hot_path_metrics& metrics)
+{
+    const std::pair<const char*, const latency_histogram*> stages[] = {
+        { "capture", &metrics.capture }, { "analyze", &metrics.analyze }, { "encode", &metrics.encode }, { "pack", &metrics.pack }, { "hid_write", &metrics.hid_write },
+    };
+
+    out << "# HELP nlctl_stage_latency_seconds Latency of one reactive-mode pipeline stage.\n";
+    out << "# TYPE nlctl_stage_latency_seconds summary\n";
+    for (const auto& [name, histogram] : stages) {
+        for (double q : { 0.5, 0.9, 0.99, 0.999 }) {
+            out << "nlctl_stage_latency_seconds{stage=\"" << name << "\",quantile=\"" << q << "\"} " << histogram->percentile_ns(q) / 1e9 << '\n';
+        }
+        out << "nlctl_stage_latency_seconds_sum{stage=\"" << name << "\"} " << histogram->sum_ns() / 1e9 << '\n';
+        out << "nlctl_stage_latency_seconds_count{stage=\"" << name << "\"} " << histogram->count() << '\n';
+    }
+
+    out << "# HELP nlctl_frames_total Frames handed to the LED strip.\n";
+    out << "# TYPE nlctl_frames_total counter\n";
+    out << "nlctl_frames_total " << metrics.frames.load(std::memory_order_relaxed) << '\n';
+}
+
+metrics_exporter::metrics_exporter(std::string path, std::chrono::milliseconds interval) : path_(std::move(path)), interval_(interval)
+{
+    thread_ = std::thread([this] {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!cv_.wait_for(lock, interval_, [this] { return stop_; }))
+            export_once();
+        export_once();
+    });
+}
+
+metrics_exporter::~metrics_exporter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    if (thread_.joinable()) thread_.join();
+}
+
+void metrics_exporter::export_once() const
+{
+    std::string temp = path_ + ".tmp";
+    {
+        std::ofstream out(temp, std::ios::trunc);
+        if (!out) {
+            std::cerr << "Warning: cannot write metrics to " << temp << '\n';
+            return;
+        }
+        write_prometheus(out, hot_path());
+    }
+    if (std::rename(temp.c_str(), path_.c_str()) != 0) {
+        std::cerr << "Warning: cannot replace " << path_ << '\n';
+    }
+}
+
+} // namespace led
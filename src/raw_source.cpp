@@ -0,0 +1,275 @@
+#include "raw_source.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool parse_raw_format(const std::string& name, PixelFormat& format)
+{
+    /** ffmpeg -pix_fmt names, matching ours except for the little-endian suffix of rgb565le */
+    static const std::pair<const char*, PixelFormat> names[] = {
+        { "bgra", PixelFormat::bgra32 },  { "bgr0", PixelFormat::bgrx32 },     { "rgba", PixelFormat::rgba32 },   { "rgb24", PixelFormat::rgb24 },
+        { "bgr24", PixelFormat::bgr24 },  { "rgb565le", PixelFormat::rgb565 }, { "rgb565", PixelFormat::rgb565 },
+    };
+    for (const auto& [n, f] : names) {
+        if (name != n) continue;
+        format = f;
+        return true;
+    }
+    return false;
+}
+
+uint64_t RawFrameSource::frame_due(clock::time_point now) const
+{
+    if (fps_num_ == 0) return next_step_ % frame_count_;
+    double seconds = std::chrono::duration<double>(now - start_).count();
+    return static_cast<uint64_t>(seconds * fps_num_ / fps_den_) % frame_count_;
+}
+
+/** Points current_ at the frame that is due and crops it, see capture(). */
+bool RawFrameSource::take_frame(float percent)
+{
+    if (frames_) {
+        auto now = clock::now();
+        if (!started_) {
+            start_ = now;
+            started_ = true;
+        }
+        shown_ = frame_due(now);
+        if (fps_num_ == 0) ++next_step_;
+        current_ = frames_ + shown_ * frame_bytes_;
+    } else {
+        if (stream_.acquire()) ++received_;
+        if (received_ == 0) return false;
+        shown_ = received_;
+        current_ = stream_.front().data();
+    }
+
+    percent = std::max(0.01f, std::min(1.0f, percent));
+    capture_width_ = static_cast<int>(width_ * percent);
+    capture_height_ = static_cast<int>(height_ * percent);
+    capture_x_ = (width_ - capture_width_) / 2;
+    capture_y_ = (height_ - capture_height_) / 2;
+    return capture_width_ > 0 && capture_height_ > 0;
+}
+
+bool RawFrameSource::capture(float percent)
+{
+    return take_frame(percent);
+}
+
+bool RawFrameSource::capture_border(float percent, int depth, int buffer)
+{
+    if (!take_frame(percent)) return false;
+
+    int w = capture_width_, h = capture_height_;
+    int d = std::max(1, std::min(depth, std::min(w, h) / 2));
+    int bpp = bytes_per_pixel(format_);
+    const uint8_t* origin = image().data;
+
+    BorderStrips& border = border_[buffer];
+    border.width = w;
+    border.height = h;
+    border.depth = d;
+    border.format = format_;
+    border.top = { origin, stride_ };
+    border.bottom = { origin + static_cast<size_t>(h - d) * stride_, stride_ };
+    border.left = { origin + static_cast<size_t>(d) * stride_, stride_ };
+    border.right = { origin + static_cast<size_t>(d) * stride_ + static_cast<size_t>(w - d) * bpp, stride_ };
+    if (frames_) return true;
+
+    /** a stream buffer goes back to the reader with the next frame, the strips must outlive that */
+    auto copy = [&](std::vector<uint8_t>& to, ImageStrip& strip, int width, int height) {
+        size_t row = static_cast<size_t>(width) * bpp;
+        to.resize(row * static_cast<size_t>(std::max(height, 0)));
+        for (int y = 0; y < height; ++y)
+            std::memcpy(to.data() + static_cast<size_t>(y) * row, strip.data + static_cast<size_t>(y) * stride_, row);
+        strip = { to.data(), static_cast<int>(row) };
+    };
+    StripCopy& copies = copies_[buffer];
+    copy(copies.top, border.top, w, d);
+    copy(copies.bottom, border.bottom, w, d);
+    copy(copies.left, border.left, d, h - 2 * d);
+    copy(copies.right, border.right, d, h - 2 * d);
+    return true;
+}
+
+bool RawFrameSource::poll_damage(std::vector<ImageRect>& damage)
+{
+    damage.clear();
+    if (frames_) return started_ && frame_due(clock::now()) == shown_;
+    if (stream_.acquire()) ++received_;
+    return received_ == shown_;
+}
+
+ImageView RawFrameSource::image() const
+{
+    if (!current_) return {};
+    const uint8_t* origin = current_ + static_cast<size_t>(capture_y_) * stride_ + static_cast<size_t>(capture_x_) * bytes_per_pixel(format_);
+    return { origin, capture_width_, capture_height_, stride_, format_ };
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+
+RawFrameSource::RawFrameSource(const std::string&)
+{
+    throw std::runtime_error("Raw video sources are not supported on Windows");
+}
+
+RawFrameSource::~RawFrameSource() = default;
+
+#else
+
+/** Reads exactly `bytes` unless the stream ends first. */
+static size_t read_fully(int fd, void* to, size_t bytes)
+{
+    size_t done = 0;
+    while (done < bytes) {
+        ssize_t n = read(fd, static_cast<uint8_t*>(to) + done, bytes - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += static_cast<size_t>(n);
+    }
+    return done;
+}
+
+RawFrameSource::RawFrameSource(const std::string& spec)
+{
+    std::vector<std::string> parts;
+    for (size_t start = 0;;) {
+        size_t end = spec.find(':', start);
+        parts.push_back(spec.substr(start, end - start));
+        if (end == std::string::npos) break;
+        start = end + 1;
+    }
+    bool headerless = parts.size() > 1;
+    if (parts[0].empty() || (headerless && parts.size() != 3 && parts.size() != 4)) {
+        throw std::runtime_error("Raw video source must be path or path:WIDTHxHEIGHT:FORMAT[:FPS], got '" + spec + "'");
+    }
+
+    RawVideoHeader header;
+    if (headerless) {
+        PixelFormat format;
+        char rest;
+        if (std::sscanf(parts[1].c_str(), "%ux%u%c", &header.width, &header.height, &rest) != 2) throw std::runtime_error("Invalid raw video size '" + parts[1] + "'");
+        if (!parse_raw_format(parts[2], format)) throw std::runtime_error("Unknown raw video format '" + parts[2] + "', use bgra, bgr0, rgba, rgb24, bgr24 or rgb565le");
+        header.format = static_cast<uint32_t>(format);
+        if (parts.size() == 4 && std::sscanf(parts[3].c_str(), "%u/%u", &header.fps_num, &header.fps_den) < 1) throw std::runtime_error("Invalid raw video rate '" + parts[3] + "'");
+    }
+
+    bool from_stdin = parts[0] == "-";
+    fd_ = from_stdin ? STDIN_FILENO : ::open(parts[0].c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) throw std::runtime_error("Cannot open raw video '" + parts[0] + "': " + std::strerror(errno));
+
+    try {
+        struct stat st;
+        if (fstat(fd_, &st) != 0) throw std::runtime_error(std::string("Cannot stat raw video: ") + std::strerror(errno));
+        bool regular = S_ISREG(st.st_mode);
+        off_t position = regular ? lseek(fd_, 0, SEEK_CUR) : 0;
+        uint64_t offset = position > 0 ? static_cast<uint64_t>(position) : 0;
+
+        if (!headerless) {
+            size_t got = regular ? static_cast<size_t>(std::max<ssize_t>(0, pread(fd_, &header, sizeof(header), static_cast<off_t>(offset))))
+                                 : read_fully(fd_, &header, sizeof(header));
+            if (got != sizeof(header) || std::memcmp(header.magic, RawVideoHeader{}.magic, sizeof(header.magic)) != 0 || header.version != 1) {
+                throw std::runtime_error("'" + parts[0] + "' has no raw video header, give its size and format as path:WIDTHxHEIGHT:FORMAT");
+            }
+            offset += sizeof(header);
+        }
+
+        if (header.width == 0 || header.height == 0 || header.width > 65535 || header.height > 65535) throw std::runtime_error("Invalid raw video size");
+        if (header.format > static_cast<uint32_t>(PixelFormat::rgb24)) throw std::runtime_error("Unknown raw video pixel format " + std::to_string(header.format));
+        if (header.fps_den == 0) throw std::runtime_error("Invalid raw video rate");
+
+        width_ = static_cast<int>(header.width);
+        height_ = static_cast<int>(header.height);
+        format_ = static_cast<PixelFormat>(header.format);
+        uint32_t row = header.width * bytes_per_pixel(format_);
+        if (header.stride != 0 && header.stride < row) throw std::runtime_error("Raw video stride is shorter than a row");
+        stride_ = static_cast<int>(header.stride ? header.stride : row);
+        frame_bytes_ = static_cast<size_t>(stride_) * height_;
+        fps_num_ = header.fps_num;
+        fps_den_ = header.fps_den;
+
+        if (regular) {
+            map_file(fd_, offset);
+            if (!from_stdin) close(fd_);
+            fd_ = -1;
+        } else {
+            /** a stream is paced by its producer */
+            fps_num_ = 0;
+            reader_ = std::thread([this] { read_stream(); });
+        }
+    } catch (...) {
+        if (!from_stdin && fd_ >= 0) close(fd_);
+        throw;
+    }
+    owns_fd_ = !from_stdin && fd_ >= 0;
+}
+
+RawFrameSource::~RawFrameSource()
+{
+    stop_.store(true, std::memory_order_relaxed);
+    if (reader_.joinable()) reader_.join();
+    if (map_) munmap(map_, map_bytes_);
+    if (owns_fd_) close(fd_);
+}
+
+/** Maps the whole file read-only, the frames start `offset` bytes in; a trailing partial frame is ignored. */
+void RawFrameSource::map_file(int fd, uint64_t offset)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0) throw std::runtime_error(std::string("Cannot stat raw video: ") + std::strerror(errno));
+    uint64_t size = static_cast<uint64_t>(st.st_size);
+    if (size < offset + frame_bytes_) throw std::runtime_error("Raw video holds no complete frame");
+
+    map_ = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map_ == MAP_FAILED) {
+        map_ = nullptr;
+        throw std::runtime_error(std::string("Cannot map raw video: ") + std::strerror(errno));
+    }
+    map_bytes_ = size;
+    frames_ = static_cast<const uint8_t*>(map_) + offset;
+    frame_count_ = (size - offset) / frame_bytes_;
+}
+
+/**
+ * Reads whole frames into the back buffer and publishes each as it completes. Waits in poll() so
+ * the destructor can stop it within 100 ms even if the producer stalls.
+ */
+void RawFrameSource::read_stream()
+{
+    size_t filled = 0;
+    while (!stop_.load(std::memory_order_relaxed)) {
+        pollfd pfd{ fd_, POLLIN, 0 };
+        int ready = poll(&pfd, 1, 100);
+        if (ready < 0 && errno != EINTR) break;
+        if (ready <= 0) continue;
+
+        std::vector<uint8_t>& frame = stream_.back();
+        frame.resize(frame_bytes_);
+        ssize_t n = read(fd_, frame.data() + filled, frame_bytes_ - filled);
+        if (n < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+        if (n <= 0) {
+            std::fprintf(stderr, "Raw video stream ended, holding the last frame\n");
+            break;
+        }
+        filled += static_cast<size_t>(n);
+        if (filled == frame_bytes_) {
+            stream_.publish();
+            filled = 0;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,86 @@
+#include "report_encoder.hpp"
+#include <algorithm>
+#include <utility>
+
+namespace led
+{
+
+static_assert(sizeof(color) == 3, "report_encoder reads colors as a packed byte array");
+
+strip_format screen_mirror_format()
+{
+    strip_format format;
+    format.orders = { { 0, k_order_grb }, { 20, k_order_rbg } };
+    format.min_reports = 3;
+    return format;
+}
+
+report_encoder::report_encoder(strip_format format) : format_(std::move(format))
+{
+    if (format_.orders.empty()) format_.orders.push_back({ 0, { 0, 1, 2 } });
+    format_.first_payload = std::clamp<size_t>(format_.first_payload, 1, k_buffer_size - 4);
+    format_.next_payload = std::clamp<size_t>(format_.next_payload, 1, k_buffer_size - 1);
+    build(0);
+}
+
+size_t report_encoder::reports_for(const strip_format& format, size_t bytes)
+{
+    size_t needed = 1;
+    if (bytes > format.first_payload) needed += (bytes - format.first_payload + format.next_payload - 1) / format.next_payload;
+    return std::max(needed, format.min_reports);
+}
+
+channel_order report_encoder::order_of(const strip_format& format, size_t zone)
+{
+    channel_order order = format.orders.front().order;
+    for (const auto& run : format.orders) {
+        if (run.first_zone > zone) break;
+        order = run.order;
+    }
+    return order;
+}
+
+/**
+ * Lays out the reports for `zones` LEDs: the command header goes in once, every color byte gets
+ * its slot, padding stays zero.
+ */
+void report_encoder::build(size_t zones)
+{
+    size_t bytes = zones * 3;
+    zones_ = zones;
+    report_count_ = reports_for(format_, bytes);
+    reports_.assign(report_count_ * k_buffer_size, 0);
+    reports_[1] = 0x02;
+    reports_[2] = (bytes >> 8) & 0xFF;
+    reports_[3] = bytes & 0xFF;
+
+    /** wire position of color byte n: after the 4-byte header in report 0, after the report ID in the others */
+    auto wire_offset = [&](size_t n) {
+        if (n < format_.first_payload) return 4 + n;
+        size_t rest = n - format_.first_payload;
+        return (1 + rest / format_.next_payload) * k_buffer_size + 1 + rest % format_.next_payload;
+    };
+
+    moves_.resize(bytes);
+    for (size_t zone = 0; zone < zones; ++zone) {
+        channel_order order = order_of(format_, zone);
+        uint32_t from = static_cast<uint32_t>(zone * 3);
+        moves_[zone * 3 + order.r] = { static_cast<uint32_t>(wire_offset(zone * 3 + order.r)), from };
+        moves_[zone * 3 + order.g] = { static_cast<uint32_t>(wire_offset(zone * 3 + order.g)), from + 1 };
+        moves_[zone * 3 + order.b] = { static_cast<uint32_t>(wire_offset(zone * 3 + order.b)), from + 2 };
+    }
+}
+
+void report_encoder::encode(std::span<const color> colors)
+{
+    /** the two-byte length field limits a frame to 21845 LEDs */
+    size_t zones = std::min<size_t>(colors.size(), 0xFFFF / 3);
+    if (zones != zones_) build(zones);
+
+    const uint8_t* source = reinterpret_cast<const uint8_t*>(colors.data());
+    uint8_t* wire = reports_.data();
+    for (const auto& move : moves_)
+        wire[move.to] = source[move.from];
+}
+
+} // namespace led
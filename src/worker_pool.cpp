@@ -0,0 +1,61 @@
+#include "worker_pool.hpp"
+#include <algorithm>
+
+WorkerPool::WorkerPool(size_t workers)
+{
+    size_t threads = std::max<size_t>(workers, 1) - 1;
+    threads_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i)
+        threads_.emplace_back([this] { worker_loop(); });
+}
+
+WorkerPool::~WorkerPool()
+{
+    stop_ = true;
+    generation_.fetch_add(1, std::memory_order_release);
+    generation_.notify_all();
+    for (auto& thread : threads_)
+        thread.join();
+}
+
+void WorkerPool::worker_loop()
+{
+    uint32_t seen = 0;
+    while (true) {
+        generation_.wait(seen, std::memory_order_acquire);
+        seen = generation_.load(std::memory_order_acquire);
+        if (stop_) return;
+
+        for (size_t i = next_.fetch_add(1, std::memory_order_relaxed); i < count_; i = next_.fetch_add(1, std::memory_order_relaxed))
+            task_(context_, i);
+
+        if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) pending_.notify_one();
+    }
+}
+
+/**
+ * Publishes the task with a generation bump, works on it alongside the workers and waits until
+ * every worker has checked in, so the next dispatch cannot race a straggler of this one.
+ */
+void WorkerPool::dispatch(size_t count, TaskFn task, void* context)
+{
+    if (threads_.empty() || count <= 1) {
+        for (size_t i = 0; i < count; ++i)
+            task(context, i);
+        return;
+    }
+
+    task_ = task;
+    context_ = context;
+    count_ = count;
+    next_.store(0, std::memory_order_relaxed);
+    pending_.store(static_cast<uint32_t>(threads_.size()), std::memory_order_relaxed);
+    generation_.fetch_add(1, std::memory_order_release);
+    generation_.notify_all();
+
+    for (size_t i = next_.fetch_add(1, std::memory_order_relaxed); i < count; i = next_.fetch_add(1, std::memory_order_relaxed))
+        task(context, i);
+
+    for (uint32_t pending = pending_.load(std::memory_order_acquire); pending != 0; pending = pending_.load(std::memory_order_acquire))
+        pending_.wait(pending, std::memory_order_acquire);
+}
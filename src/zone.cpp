@@ -1,66 +1,334 @@
 #include <algorithm>
+#include "worker_pool.hpp"
 #include "zone.hpp"
 
-ZoneAnalyzer::ZoneAnalyzer(int zone_depth) : zone_depth_(zone_depth)
+static int samples_per_axis(int length, int stride)
 {
+    return (length + stride - 1) / stride;
 }
 
-ZoneColor ZoneAnalyzer::average_region(uint8_t* data, int img_width, int bpp, int x_start, int y_start, int region_width, int region_height)
+static bool intersects(const ZoneRect& zone, const ImageRect& area)
 {
-    uint64_t r_sum = 0, g_sum = 0, b_sum = 0;
-    int pixel_count = 0;
-
-    for (int y = y_start; y < y_start + region_height; ++y) {
-        for (int x = x_start; x < x_start + region_width; ++x) {
-            int idx = (y * img_width + x) * bpp;
+    return zone.x < area.x + area.width && area.x < zone.x + zone.width && zone.y < area.y + area.height && area.y < zone.y + zone.height;
+}
 
-            // Assuming BGRA format (common for X11)
-            b_sum += data[idx];
-            g_sum += data[idx + 1];
-            r_sum += data[idx + 2];
-            pixel_count++;
-        }
+/** Calls `visit.template operator()<F>()` with the compile-time constant for `format`. */
+template <typename Visit>
+static void visit_format(PixelFormat format, Visit&& visit)
+{
+    switch (format) {
+        case PixelFormat::bgra32: visit.template operator()<PixelFormat::bgra32>(); break;
+        case PixelFormat::bgrx32: visit.template operator()<PixelFormat::bgrx32>(); break;
+        case PixelFormat::bgr24: visit.template operator()<PixelFormat::bgr24>(); break;
+        case PixelFormat::rgb565: visit.template operator()<PixelFormat::rgb565>(); break;
+        case PixelFormat::rgba32: visit.template operator()<PixelFormat::rgba32>(); break;
+        case PixelFormat::rgb24: visit.template operator()<PixelFormat::rgb24>(); break;
     }
+}
+
+static PixelFormat packed_format(int bpp)
+{
+    if (bpp == 3) return PixelFormat::bgr24;
+    if (bpp == 2) return PixelFormat::rgb565;
+    return PixelFormat::bgrx32;
+}
 
-    return { static_cast<float>(r_sum) / pixel_count / 255.0f, static_cast<float>(g_sum) / pixel_count / 255.0f, static_cast<float>(b_sum) / pixel_count / 255.0f };
+ZoneAnalyzer::ZoneAnalyzer(int zone_depth, int sample_stride) : zone_depth_(zone_depth), sample_stride_(std::max(1, sample_stride)), kernel_(select_bgra_kernel())
+{
 }
-std::vector<ZoneColor> ZoneAnalyzer::analyze(uint8_t* img_data, int width, int height, int bpp, int bottom_zones, int left_zones, int top_zones, int right_zones)
+
+/**
+ * Computes the zone rectangles for a geometry and splits them into horizontal bands,
+ * so that analyze() can stream each row once and feed every zone it crosses.
+ */
+void ZoneAnalyzer::build_layout(int width, int height, int depth, int bottom_zones, int left_zones, int top_zones, int right_zones)
 {
     int total = bottom_zones + left_zones - 1 + top_zones - 2 + right_zones - 1;
-    std::vector<ZoneColor> zones(total);
+    rects_.assign(total, ZoneRect{ 0, 0, 0, 0 });
+
+    for (int i = 0; i < bottom_zones; ++i) {
+        int rev_i = bottom_zones - 1 - i;
+        int x = rev_i * (width / bottom_zones);
+        int w = (rev_i == bottom_zones - 1) ? width - x : width / bottom_zones;
+        rects_[i] = { x, height - depth, w, depth };
+    }
+
+    for (int i = 0; i < left_zones - 1; ++i) {
+        int rev_i = left_zones - 2 - i;
+        int y = rev_i * (height / left_zones);
+        int h = (rev_i == left_zones - 1) ? height - y : height / left_zones;
+        rects_[bottom_zones + i] = { 0, y, depth, h };
+    }
 
-    int depth = std::min(zone_depth_, std::min(width, height) / 2);
+    for (int i = 0; i < top_zones - 2; ++i) {
+        int actual_i = i + 1;
+        rects_[bottom_zones + left_zones - 1 + i] = { actual_i * (width / top_zones), 0, width / top_zones, depth };
+    }
 
-#pragma omp parallel
-    {
-        int idx = 0;
+    for (int i = 0; i < right_zones - 1; ++i) {
+        rects_[bottom_zones + left_zones - 1 + top_zones - 2 + i] = { width - depth, i * (height / right_zones), depth, height / right_zones };
+    }
 
-#pragma omp for schedule(static)
-        for (int i = 0; i < bottom_zones; ++i) {
-            int rev_i = bottom_zones - 1 - i;
-            int x = rev_i * (width / bottom_zones);
-            int w = (rev_i == bottom_zones - 1) ? width - x : width / bottom_zones;
-            zones[i] = average_region(img_data, width, bpp, x, height - depth, w, depth);
-        }
+    std::vector<int> edges;
+    edges.reserve(rects_.size() * 2);
+    for (const auto& r : rects_) {
+        if (r.width <= 0 || r.height <= 0) continue;
+        edges.push_back(r.y);
+        edges.push_back(r.y + r.height);
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
 
-#pragma omp for schedule(static)
-        for (int i = 0; i < left_zones - 1; ++i) {
-            int rev_i = left_zones - 2 - i;
-            int y = rev_i * (height / left_zones);
-            int h = (rev_i == left_zones - 1) ? height - y : height / left_zones;
-            zones[bottom_zones + i] = average_region(img_data, width, bpp, 0, y, depth, h);
+    spans_.clear();
+    bands_.clear();
+    for (size_t e = 0; e + 1 < edges.size(); ++e) {
+        Band band{ edges[e], edges[e + 1], spans_.size(), 0 };
+        for (size_t z = 0; z < rects_.size(); ++z) {
+            const auto& r = rects_[z];
+            if (r.width <= 0 || r.height <= 0) continue;
+            if (r.y <= band.y_begin && r.y + r.height >= band.y_end) {
+                spans_.push_back({ r.x, r.width, static_cast<int>(z), r.y });
+            }
         }
+        band.span_count = spans_.size() - band.first_span;
+        if (band.span_count == 0) continue;
+
+        std::sort(spans_.begin() + band.first_span, spans_.end(), [](const Span& a, const Span& b) { return a.x < b.x; });
+        bands_.push_back(band);
+    }
 
-#pragma omp for schedule(static)
-        for (int i = 0; i < top_zones - 2; ++i) {
-            int actual_i = i + 1;
-            zones[bottom_zones + left_zones - 1 + i] = average_region(img_data, width, bpp, actual_i * (width / top_zones), 0, width / top_zones, depth);
+    layout_ = { width, height, depth, sample_stride_, bottom_zones, left_zones, top_zones, right_zones };
+    tile_workers_ = 0;
+}
+
+/**
+ * Cuts every zone into runs of sampled rows holding about a quarter of a worker's share of the
+ * sampled pixels each, so that the dynamic hand-out in WorkerPool::run() evens out the load.
+ */
+void ZoneAnalyzer::build_tiles(size_t workers)
+{
+    int stride = sample_stride_;
+    size_t total = 0;
+    for (const auto& r : rects_) {
+        if (r.width > 0 && r.height > 0) total += static_cast<size_t>(samples_per_axis(r.width, stride)) * samples_per_axis(r.height, stride);
+    }
+    size_t target = std::max(k_min_tile_pixels, total / (workers * 4));
+
+    tiles_.clear();
+    for (size_t z = 0; z < rects_.size(); ++z) {
+        const auto& r = rects_[z];
+        if (r.width <= 0 || r.height <= 0) continue;
+
+        size_t row_samples = static_cast<size_t>(samples_per_axis(r.width, stride));
+        int rows = static_cast<int>(std::max<size_t>(1, target / row_samples)) * stride;
+        for (int y = r.y; y < r.y + r.height; y += rows)
+            tiles_.push_back({ static_cast<int>(z), r.x, r.width, y, std::min(y + rows, r.y + r.height) });
+    }
+    tile_sums_.resize(tiles_.size());
+    tile_workers_ = workers;
+}
+
+void ZoneAnalyzer::prepare(int width, int height, int depth, int bottom_zones, int left_zones, int top_zones, int right_zones, const std::span<const ImageRect>* damage)
+{
+    const Layout& l = layout_;
+    bool rebuilt = false;
+    if (l.width != width || l.height != height || l.depth != depth || l.stride != sample_stride_ || l.bottom != bottom_zones || l.left != left_zones || l.top != top_zones ||
+        l.right != right_zones) {
+        build_layout(width, height, depth, bottom_zones, left_zones, top_zones, right_zones);
+        rebuilt = true;
+    }
+
+    /** cached colors are only reusable for the exact same layout */
+    partial_ = damage && !rebuilt && colors_.size() == rects_.size();
+    dirty_.assign(rects_.size(), 1);
+    sums_.resize(rects_.size());
+    recomputed_ = 0;
+    work_pixels_ = 0;
+
+    for (size_t z = 0; z < rects_.size(); ++z) {
+        if (partial_) {
+            dirty_[z] = std::any_of(damage->begin(), damage->end(), [&](const ImageRect& area) { return intersects(rects_[z], area); });
+        }
+        if (dirty_[z]) {
+            sums_[z] = ChannelSums{};
+            recomputed_++;
+            const auto& r = rects_[z];
+            if (r.width > 0 && r.height > 0) work_pixels_ += static_cast<size_t>(samples_per_axis(r.width, sample_stride_)) * samples_per_axis(r.height, sample_stride_);
         }
+    }
+}
+
+/** Sums a run of `pixels` sampling every `stride`-th one; 32-bit pixels use the selected SIMD kernel. */
+template <PixelFormat F>
+void ZoneAnalyzer::sum_pixels(const uint8_t* row, int pixels, int stride, ChannelSums& sums) const
+{
+    if (stride > 1) {
+        sum_row_strided<F>(row, pixels, stride, sums);
+    } else if constexpr (F == PixelFormat::rgba32) {
+        /** the BGRA kernel takes red for blue, swapping the totals is cheaper than a kernel of its own */
+        ChannelSums swapped{ 0, 0, 0 };
+        kernel_(row, pixels, swapped);
+        sums.r += swapped.b;
+        sums.g += swapped.g;
+        sums.b += swapped.r;
+    } else if constexpr (PixelTraits<F>::bytes == 4) {
+        kernel_(row, pixels, sums);
+    } else {
+        sum_row<F>(row, pixels, sums);
+    }
+}
 
-#pragma omp for schedule(static)
-        for (int i = 0; i < right_zones - 1; ++i) {
-            zones[bottom_zones + left_zones - 1 + top_zones - 2 + i] = average_region(img_data, width, bpp, width - depth, i * (height / right_zones), depth, height / right_zones);
+/**
+ * Streams every band row by row, `pixel_at(x, y)` maps frame coordinates to the pixel in memory.
+ */
+template <PixelFormat F, typename PixelAt>
+void ZoneAnalyzer::accumulate(PixelAt pixel_at)
+{
+    last_tiles_ = 0;
+    if (recomputed_ == 0) return;
+    if (pool_ && pool_->size() > 1 && work_pixels_ >= k_min_parallel_pixels) {
+        accumulate_tiles<F>(pixel_at);
+        return;
+    }
+    int stride = sample_stride_;
+
+    for (const auto& band : bands_) {
+        const Span* first = spans_.data() + band.first_span;
+        const Span* last = first + band.span_count;
+
+        for (int y = band.y_begin; y < band.y_end; ++y) {
+            for (const Span* s = first; s != last; ++s) {
+                if (partial_ && !dirty_[s->zone]) continue;
+                if (stride > 1 && (y - s->zone_y) % stride != 0) continue;
+                sum_pixels<F>(pixel_at(s->x, y), s->width, stride, sums_[s->zone]);
+            }
         }
     }
-    return zones;
+}
+
+/**
+ * Parallel variant of accumulate(): every tile is summed into its own slot, which are then added
+ * up per zone, so no two workers ever write the same totals.
+ */
+template <PixelFormat F, typename PixelAt>
+void ZoneAnalyzer::accumulate_tiles(PixelAt pixel_at)
+{
+    if (tile_workers_ != pool_->size()) build_tiles(pool_->size());
+    int stride = sample_stride_;
+
+    auto sum_tile = [&](size_t t) {
+        const Tile& tile = tiles_[t];
+        ChannelSums& sums = tile_sums_[t];
+        sums = ChannelSums{};
+        if (partial_ && !dirty_[tile.zone]) return;
+
+        for (int y = tile.y_begin; y < tile.y_end; y += stride)
+            sum_pixels<F>(pixel_at(tile.x, y), tile.width, stride, sums);
+    };
+    pool_->run(tiles_.size(), sum_tile);
+
+    for (size_t t = 0; t < tiles_.size(); ++t) {
+        ChannelSums& zone = sums_[tiles_[t].zone];
+        zone.r += tile_sums_[t].r;
+        zone.g += tile_sums_[t].g;
+        zone.b += tile_sums_[t].b;
+    }
+    last_tiles_ = tiles_.size();
+}
+
+const std::vector<ZoneColor>& ZoneAnalyzer::resolve()
+{
+    int stride = sample_stride_;
+    colors_.resize(rects_.size());
+    for (size_t z = 0; z < rects_.size(); ++z) {
+        if (!dirty_[z]) continue;
+
+        uint64_t pixel_count = static_cast<uint64_t>(samples_per_axis(rects_[z].width, stride)) * samples_per_axis(rects_[z].height, stride);
+        const auto& s = sums_[z];
+        auto average = [&](uint64_t sum) { return pixel_count ? static_cast<uint16_t>(((sum << 8) + pixel_count / 2) / pixel_count) : uint16_t(0); };
+        colors_[z] = { average(s.r), average(s.g), average(s.b) };
+    }
+    return colors_;
+}
+
+const std::vector<ZoneColor>& ZoneAnalyzer::analyze_image(const ImageView& image, int bottom_zones, int left_zones, int top_zones, int right_zones)
+{
+    int depth = std::min(zone_depth_, std::min(image.width, image.height) / 2);
+    prepare(image.width, image.height, depth, bottom_zones, left_zones, top_zones, right_zones, nullptr);
+
+    /** rows may be padded, e.g. to the scanline alignment of an XImage */
+    size_t row_bytes = static_cast<size_t>(image.stride);
+    visit_format(image.format, [&]<PixelFormat F>() {
+        accumulate<F>([&](int x, int y) { return image.data + y * row_bytes + x * PixelTraits<F>::bytes; });
+    });
+    return resolve();
+}
+
+const std::vector<ZoneColor>& ZoneAnalyzer::analyze_strips(const BorderStrips& strips, int bottom_zones, int left_zones, int top_zones, int right_zones,
+                                                          const std::span<const ImageRect>* damage)
+{
+    int width = strips.width, height = strips.height;
+    int edge = strips.depth;
+    int depth = std::min({ zone_depth_, edge, std::min(width, height) / 2 });
+    prepare(width, height, depth, bottom_zones, left_zones, top_zones, right_zones, damage);
+
+    /** zones never cross a strip boundary, so every span lies entirely inside one strip */
+    visit_format(strips.format, [&]<PixelFormat F>() {
+        constexpr int bpp = PixelTraits<F>::bytes;
+        accumulate<F>([&](int x, int y) {
+            if (y < edge) return strips.top.data + y * strips.top.stride + x * bpp;
+            if (y >= height - edge) return strips.bottom.data + (y - (height - edge)) * strips.bottom.stride + x * bpp;
+            if (x < edge) return strips.left.data + (y - edge) * strips.left.stride + x * bpp;
+            return strips.right.data + (y - edge) * strips.right.stride + (x - (width - edge)) * bpp;
+        });
+    });
+    return resolve();
+}
+
+size_t ZoneAnalyzer::copy_out(const std::vector<ZoneColor>& colors, std::span<ZoneColor> out)
+{
+    size_t count = std::min(colors.size(), out.size());
+    std::copy_n(colors.begin(), count, out.begin());
+    return count;
+}
+
+std::vector<ZoneColor> ZoneAnalyzer::analyze(const ImageView& image, int bottom_zones, int left_zones, int top_zones, int right_zones)
+{
+    return analyze_image(image, bottom_zones, left_zones, top_zones, right_zones);
+}
+
+std::vector<ZoneColor> ZoneAnalyzer::analyze(uint8_t* img_data, int width, int height, int bpp, int bottom_zones, int left_zones, int top_zones, int right_zones)
+{
+    return analyze_image({ img_data, width, height, width * bpp, packed_format(bpp) }, bottom_zones, left_zones, top_zones, right_zones);
+}
+
+std::vector<ZoneColor> ZoneAnalyzer::analyze(const BorderStrips& strips, int bottom_zones, int left_zones, int top_zones, int right_zones)
+{
+    return analyze_strips(strips, bottom_zones, left_zones, top_zones, right_zones, nullptr);
+}
+
+std::vector<ZoneColor> ZoneAnalyzer::analyze(const BorderStrips& strips, int bottom_zones, int left_zones, int top_zones, int right_zones, const std::vector<ImageRect>& damage)
+{
+    std::span<const ImageRect> areas(damage);
+    return analyze_strips(strips, bottom_zones, left_zones, top_zones, right_zones, &areas);
+}
+
+size_t ZoneAnalyzer::analyze(const ImageView& image, int bottom_zones, int left_zones, int top_zones, int right_zones, std::span<ZoneColor> out)
+{
+    return copy_out(analyze_image(image, bottom_zones, left_zones, top_zones, right_zones), out);
+}
+
+size_t ZoneAnalyzer::analyze(uint8_t* img_data, int width, int height, int bpp, int bottom_zones, int left_zones, int top_zones, int right_zones, std::span<ZoneColor> out)
+{
+    return copy_out(analyze_image({ img_data, width, height, width * bpp, packed_format(bpp) }, bottom_zones, left_zones, top_zones, right_zones), out);
+}
+
+size_t ZoneAnalyzer::analyze(const BorderStrips& strips, int bottom_zones, int left_zones, int top_zones, int right_zones, std::span<ZoneColor> out)
+{
+    return copy_out(analyze_strips(strips, bottom_zones, left_zones, top_zones, right_zones, nullptr), out);
+}
+
+size_t ZoneAnalyzer::analyze(const BorderStrips& strips, int bottom_zones, int left_zones, int top_zones, int right_zones, std::span<const ImageRect> damage, std::span<ZoneColor> out)
+{
+    return copy_out(analyze_strips(strips, bottom_zones, left_zones, top_zones, right_zones, &damage), out);
 }
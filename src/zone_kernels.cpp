@@ -0,0 +1,117 @@
+#include "zone_kernels.hpp"
+#include "cpu_features.hpp"
+
+#ifdef NLCTL_X86
+#include <immintrin.h>
+#endif
+
+void sum_bgra_scalar(const uint8_t* row, int pixels, ChannelSums& sums)
+{
+    uint64_t r_sum = 0, g_sum = 0, b_sum = 0;
+    for (int i = 0; i < pixels; ++i) {
+        b_sum += row[i * 4];
+        g_sum += row[i * 4 + 1];
+        r_sum += row[i * 4 + 2];
+    }
+    sums.r += r_sum;
+    sums.g += g_sum;
+    sums.b += b_sum;
+}
+
+#ifdef NLCTL_X86
+
+/**
+ * Masking one channel out of each 32-bit pixel and running psadbw against zero
+ * leaves the sum of that channel over 8 bytes (2 pixels) in each 64-bit lane,
+ * so the accumulators can never overflow and the totals stay exact.
+ */
+NLCTL_TARGET("sse2") void sum_bgra_sse2(const uint8_t* row, int pixels, ChannelSums& sums)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mask_b = _mm_set1_epi32(0x000000FF);
+    const __m128i mask_g = _mm_set1_epi32(0x0000FF00);
+    const __m128i mask_r = _mm_set1_epi32(0x00FF0000);
+    __m128i acc_b = zero, acc_g = zero, acc_r = zero;
+
+    int i = 0;
+    for (; i + 4 <= pixels; i += 4) {
+        __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i * 4));
+        acc_b = _mm_add_epi64(acc_b, _mm_sad_epu8(_mm_and_si128(px, mask_b), zero));
+        acc_g = _mm_add_epi64(acc_g, _mm_sad_epu8(_mm_and_si128(px, mask_g), zero));
+        acc_r = _mm_add_epi64(acc_r, _mm_sad_epu8(_mm_and_si128(px, mask_r), zero));
+    }
+
+    alignas(16) uint64_t lanes[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc_b);
+    sums.b += lanes[0] + lanes[1];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc_g);
+    sums.g += lanes[0] + lanes[1];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc_r);
+    sums.r += lanes[0] + lanes[1];
+
+    sum_bgra_scalar(row + i * 4, pixels - i, sums);
+}
+
+NLCTL_TARGET("avx2") void sum_bgra_avx2(const uint8_t* row, int pixels, ChannelSums& sums)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i mask_b = _mm256_set1_epi32(0x000000FF);
+    const __m256i mask_g = _mm256_set1_epi32(0x0000FF00);
+    const __m256i mask_r = _mm256_set1_epi32(0x00FF0000);
+    __m256i acc_b = zero, acc_g = zero, acc_r = zero;
+
+    int i = 0;
+    for (; i + 8 <= pixels; i += 8) {
+        __m256i px = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i * 4));
+        acc_b = _mm256_add_epi64(acc_b, _mm256_sad_epu8(_mm256_and_si256(px, mask_b), zero));
+        acc_g = _mm256_add_epi64(acc_g, _mm256_sad_epu8(_mm256_and_si256(px, mask_g), zero));
+        acc_r = _mm256_add_epi64(acc_r, _mm256_sad_epu8(_mm256_and_si256(px, mask_r), zero));
+    }
+
+    alignas(32) uint64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc_b);
+    sums.b += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc_g);
+    sums.g += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc_r);
+    sums.r += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+    /** the tail runs legacy SSE code, avoid the AVX-SSE transition penalty */
+    _mm256_zeroupper();
+    sum_bgra_sse2(row + i * 4, pixels - i, sums);
+}
+
+RowSumKernel select_bgra_kernel()
+{
+    if (cpu_has_avx2()) return sum_bgra_avx2;
+    if (cpu_has_sse2()) return sum_bgra_sse2;
+    return sum_bgra_scalar;
+}
+
+#else
+
+void sum_bgra_sse2(const uint8_t* row, int pixels, ChannelSums& sums)
+{
+    sum_bgra_scalar(row, pixels, sums);
+}
+
+void sum_bgra_avx2(const uint8_t* row, int pixels, ChannelSums& sums)
+{
+    sum_bgra_scalar(row, pixels, sums);
+}
+
+RowSumKernel select_bgra_kernel()
+{
+    return sum_bgra_scalar;
+}
+
+#endif
+
+const char* bgra_kernel_name(RowSumKernel kernel)
+{
+#ifdef NLCTL_X86
+    if (kernel == sum_bgra_avx2) return "avx2";
+    if (kernel == sum_bgra_sse2) return "sse2";
+#endif
+    return "scalar";
+}
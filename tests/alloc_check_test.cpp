@@ -0,0 +1,211 @@
+/**
+ * Verifies that the steady-state frame path does not touch the heap: after a warm-up it runs the
+ * analysis and playback loops, and the screen animation from a raw video file onto loopback
+ * strips through their writer threads, under a counting global operator new and fails on any
+ * allocation on any thread.
+ */
+#include "animations.hpp"
+#include "loopback_device.hpp"
+#include "raw_source.hpp"
+#include "worker_pool.hpp"
+#include "zone.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <thread>
+#include <vector>
+
+/** counted by the replaced operator new in alloc_counter.cpp */
+extern std::atomic<uint64_t> g_allocations;
+
+/**
+ * Runs `frame(i)` `warmup` times, then `frames` more times and returns the allocations of the latter.
+ */
+template <typename Frame>
+static uint64_t count_allocations(int warmup, int frames, Frame frame)
+{
+    for (int i = 0; i < warmup; ++i)
+        frame(i);
+    uint64_t before = g_allocations.load(std::memory_order_relaxed);
+    for (int i = 0; i < frames; ++i)
+        frame(warmup + i);
+    return g_allocations.load(std::memory_order_relaxed) - before;
+}
+
+/**
+ * Runs pipelined `anim` on a thread of its own for `warmup`, then returns the allocations of all
+ * threads during the following `window`.
+ */
+static uint64_t count_pipeline_allocations(led::screen_zone_animation& anim, std::chrono::milliseconds warmup, std::chrono::milliseconds window)
+{
+    std::thread run([&anim] { anim.run(); });
+    std::this_thread::sleep_for(warmup);
+    uint64_t before = g_allocations.load(std::memory_order_relaxed);
+    std::this_thread::sleep_for(window);
+    uint64_t allocations = g_allocations.load(std::memory_order_relaxed) - before;
+    anim.stop();
+    run.join();
+    return allocations;
+}
+
+/**
+ * Writes `frames` BGRA frames of moving gradients to `path`, played one frame per capture and
+ * looped, so every capture of the screen animation sees a new frame.
+ */
+static void write_raw_video(const std::filesystem::path& path, int width, int height, int frames)
+{
+    RawVideoHeader header;
+    header.width = static_cast<uint32_t>(width);
+    header.height = static_cast<uint32_t>(height);
+    header.format = static_cast<uint32_t>(PixelFormat::bgra32);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    std::vector<uint8_t> frame(static_cast<size_t>(width) * height * 4);
+    for (int f = 0; f < frames; ++f) {
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                uint8_t* px = &frame[(static_cast<size_t>(y) * width + x) * 4];
+                px[0] = static_cast<uint8_t>(x + f * 31);
+                px[1] = static_cast<uint8_t>(y + f * 17);
+                px[2] = static_cast<uint8_t>(x + y + f * 7);
+                px[3] = 0xFF;
+            }
+        }
+        out.write(reinterpret_cast<const char*>(frame.data()), static_cast<std::streamsize>(frame.size()));
+    }
+}
+
+int main()
+{
+    const int width = 1920, height = 1080, depth = 10;
+    const int bottom = 10, left = 10, top = 10, right = 10;
+    const int warmup = 3, frames = 200;
+
+    std::vector<uint8_t> top_strip(static_cast<size_t>(width) * depth * 4), bottom_strip(top_strip.size());
+    std::vector<uint8_t> left_strip(static_cast<size_t>(height - 2 * depth) * depth * 4), right_strip(left_strip.size());
+    for (size_t i = 0; i < top_strip.size(); ++i)
+        top_strip[i] = bottom_strip[i] = static_cast<uint8_t>(i * 7);
+    for (size_t i = 0; i < left_strip.size(); ++i)
+        left_strip[i] = right_strip[i] = static_cast<uint8_t>(i * 13);
+
+    BorderStrips strips;
+    strips.width = width;
+    strips.height = height;
+    strips.depth = depth;
+    strips.top = { top_strip.data(), width * 4 };
+    strips.bottom = { bottom_strip.data(), width * 4 };
+    strips.left = { left_strip.data(), depth * 4 };
+    strips.right = { right_strip.data(), depth * 4 };
+
+    ZoneAnalyzer analyzer(depth);
+    std::vector<ZoneColor> zones(ZoneAnalyzer::zone_count(bottom, left, top, right));
+    std::vector<ImageRect> damage{ { 0, 0, 200, 50 }, { width - 40, height / 2, 40, 40 } };
+
+    struct result
+    {
+        const char* name;
+        uint64_t allocations;
+        /** what was counted when it was not `frames` frames */
+        const char* span = nullptr;
+    };
+    std::vector<result> results;
+    results.reserve(16);
+
+    results.push_back({ "analyze full", count_allocations(warmup, frames, [&](int) { analyzer.analyze(strips, bottom, left, top, right, std::span<ZoneColor>(zones)); }) });
+    results.push_back({ "analyze damage", count_allocations(warmup, frames, [&](int i) {
+                           damage[0].x = (i * 37) % (width - 200);
+                           analyzer.analyze(strips, bottom, left, top, right, damage, zones);
+                       }) });
+
+    /** deep zones, so the work crosses the threshold for the pool */
+    WorkerPool pool(3);
+    ZoneAnalyzer pooled(50);
+    pooled.set_worker_pool(&pool);
+    std::vector<uint8_t> image(static_cast<size_t>(width) * height * 4, 0x40);
+    results.push_back({ "analyze pooled", count_allocations(warmup, frames, [&](int) {
+                           pooled.analyze(image.data(), width, height, 4, bottom, left, top, right, std::span<ZoneColor>(zones));
+                       }) });
+
+    led::frame_table table = led::render_cycle(100, zones.size(), [](size_t frame, size_t n, led::color16* out) {
+        led::wave_animation::render_frame({ 255, 0, 0 }, frame, n, out);
+    });
+    led::color_encoder encoder(2.2, true);
+    std::vector<led::color> colors;
+    results.push_back({ "table playback", count_allocations(warmup, frames, [&](int i) { encoder.encode(table.row(static_cast<size_t>(i) % table.frames()), colors); }) });
+    results.push_back({ "encode zones", count_allocations(warmup, frames, [&](int) { encoder.encode(std::span<const ZoneColor>(zones), colors); }) });
+
+    led::frame_interpolator interpolator(std::chrono::milliseconds(50));
+    auto t0 = std::chrono::steady_clock::now();
+    results.push_back({ "interpolate", count_allocations(warmup, frames, [&](int i) {
+                           auto now = t0 + std::chrono::milliseconds(i * 8);
+                           if (i % 6 == 0) interpolator.retarget(std::span<const ZoneColor>(zones), now);
+                           encoder.encode(interpolator.sample(now), colors);
+                       }) });
+
+    /**
+     * Every frame differs from the last, so the writer thread writes each one. The strip is not
+     * the stock one: its own channel orders and report split, given to both ends alike.
+     */
+    led::strip_format format;
+    format.orders = { { 0, { 0, 1, 2 } }, { 12, led::k_order_grb } };
+    format.first_payload = 30;
+    format.next_payload = 48;
+    led::hid_device_wrapper strip(std::make_unique<led::loopback_device>(zones.size(), std::chrono::microseconds(0), format), false, format);
+    auto& loopback = static_cast<led::loopback_device&>(strip.transport());
+    std::vector<led::color> frame_colors(strip.zone_count());
+    results.push_back({ "set_colors", count_allocations(warmup, frames, [&](int i) {
+                           for (size_t z = 0; z < frame_colors.size(); ++z)
+                               frame_colors[z] = { static_cast<uint8_t>(i + z), static_cast<uint8_t>(i * 3), static_cast<uint8_t>(z) };
+                           uint64_t written = loopback.frames();
+                           strip.set_colors(frame_colors);
+                           while (loopback.frames() == written)
+                               std::this_thread::yield();
+                       }) });
+    std::vector<led::color> decoded = loopback.last_frame();
+    bool round_trip = std::equal(decoded.begin(), decoded.end(), frame_colors.begin(), frame_colors.end(),
+                                 [](const led::color& a, const led::color& b) { return a.r == b.r && a.g == b.g && a.b == b.b; });
+    if (!round_trip) std::printf("set_colors: the strip decoded other colors than were sent\n");
+
+    /** the screen animation from a raw video onto two loopback strips, one of them on a layout of its own */
+    auto video = std::filesystem::temp_directory_path() / "nlctl_alloc_check.nlrv";
+    write_raw_video(video, 320, 180, 8);
+    led::zone_layout layout_a{ 10, 10, 10, 10, {} }, layout_b{ 5, 5, 5, 5, {} };
+    led::hid_device_wrapper strip_a(std::make_unique<led::loopback_device>(layout_a.zone_count()));
+    led::hid_device_wrapper strip_b(std::make_unique<led::loopback_device>(layout_b.zone_count()));
+
+    for (bool interpolated : { false, true }) {
+        led::screen_zone_settings settings;
+        settings.zone_depth = depth;
+        settings.source = video.string();
+        settings.fps = interpolated ? 100 : 500;
+        settings.output_fps = interpolated ? 500 : 0;
+
+        led::screen_zone_animation serial(strip_a, layout_a, settings);
+        serial.add_strip(strip_b, layout_b);
+        results.push_back({ interpolated ? "step eased" : "step", count_allocations(warmup, frames, [&](int) { serial.run(); }) });
+
+        settings.pipelined = true;
+        led::screen_zone_animation pipelined(strip_a, layout_a, settings);
+        pipelined.add_strip(strip_b, layout_b);
+        results.push_back({ interpolated ? "pipeline eased" : "pipeline", count_pipeline_allocations(pipelined, std::chrono::milliseconds(100), std::chrono::milliseconds(400)), "400 ms" });
+    }
+    std::filesystem::remove(video);
+
+    /** no allocations are no proof if nothing reached the strips */
+    uint64_t screen_frames = static_cast<led::loopback_device&>(strip_b.transport()).frames();
+    bool ok = round_trip && screen_frames >= static_cast<uint64_t>(frames);
+    if (!ok) std::printf("screen animation wrote only %llu frames\n", static_cast<unsigned long long>(screen_frames));
+    for (const auto& r : results) {
+        if (r.span)
+            std::printf("%-16s %8llu allocations in %s\n", r.name, static_cast<unsigned long long>(r.allocations), r.span);
+        else
+            std::printf("%-16s %8llu allocations in %d frames\n", r.name, static_cast<unsigned long long>(r.allocations), frames);
+        ok = ok && r.allocations == 0;
+    }
+    return ok ? 0 : 1;
+}
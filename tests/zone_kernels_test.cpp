@@ -0,0 +1,86 @@
+/**
+ * Checks the SIMD BGRA summing kernels against the scalar one on random frames: every width up to
+ * a few vector lengths plus real screen widths, strip depths from 1 to 50 rows, padded row
+ * strides and unaligned starting addresses. The kernels must agree exactly, not approximately.
+ */
+#include "cpu_features.hpp"
+#include "zone_kernels.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+struct kernel_case
+{
+    const char* name;
+    RowSumKernel kernel;
+    bool supported;
+};
+
+/**
+ * Sums a `width` x `depth` region of `frame`, rows `stride` bytes apart, with `kernel`.
+ */
+static ChannelSums sum_region(RowSumKernel kernel, const uint8_t* frame, int width, int depth, int stride)
+{
+    ChannelSums sums{ 0, 0, 0 };
+    for (int y = 0; y < depth; ++y)
+        kernel(frame + static_cast<size_t>(y) * stride, width, sums);
+    return sums;
+}
+
+int main()
+{
+    const kernel_case kernels[] = { { "sse2", sum_bgra_sse2, cpu_has_sse2() }, { "avx2", sum_bgra_avx2, cpu_has_avx2() } };
+
+    std::vector<int> widths;
+    for (int w = 0; w <= 70; ++w)
+        widths.push_back(w);
+    for (int w : { 127, 128, 129, 1366, 1920, 2560, 3840, 7680 })
+        widths.push_back(w);
+    const int depths[] = { 1, 2, 3, 10, 50 };
+    const int paddings[] = { 0, 4, 12, 60 };
+    const int offsets[] = { 0, 1, 3, 4 };
+
+    std::mt19937 random(20261017);
+    std::vector<uint8_t> frame;
+    size_t cases = 0, failures = 0;
+
+    for (const auto& k : kernels) {
+        if (!k.supported) {
+            std::printf("%s: not supported by this CPU, skipped\n", k.name);
+            continue;
+        }
+
+        for (int width : widths) {
+            for (int depth : depths) {
+                for (int padding : paddings) {
+                    for (int offset : offsets) {
+                        int stride = width * 4 + padding;
+                        frame.resize(static_cast<size_t>(stride) * depth + offset);
+                        /** every byte random, so the alpha channel must be masked out too */
+                        for (auto& byte : frame)
+                            byte = static_cast<uint8_t>(random());
+                        /** saturated rows catch lanes that would overflow */
+                        if (depth == 50) std::fill(frame.begin(), frame.begin() + stride, uint8_t{ 0xFF });
+
+                        const uint8_t* start = frame.data() + offset;
+                        ChannelSums expected = sum_region(sum_bgra_scalar, start, width, depth, stride);
+                        ChannelSums actual = sum_region(k.kernel, start, width, depth, stride);
+                        ++cases;
+                        if (actual.r == expected.r && actual.g == expected.g && actual.b == expected.b) continue;
+
+                        if (++failures <= 10) {
+                            std::printf("%s: width %d depth %d stride %d offset %d: got %llu,%llu,%llu expected %llu,%llu,%llu\n", k.name, width, depth, stride, offset,
+                                        static_cast<unsigned long long>(actual.r), static_cast<unsigned long long>(actual.g), static_cast<unsigned long long>(actual.b),
+                                        static_cast<unsigned long long>(expected.r), static_cast<unsigned long long>(expected.g), static_cast<unsigned long long>(expected.b));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    std::printf("%zu cases, %zu mismatches\n", cases, failures);
+    return failures == 0 ? 0 : 1;
+}
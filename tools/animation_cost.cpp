@@ -0,0 +1,107 @@
+/**
+ * Compares the per-frame CPU cost of rendering the periodic animations on the fly, as they used
+ * to, against playing back their precomputed frame tables through the color encoder.
+ */
+#include "animations.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace led;
+
+struct cost_report
+{
+    const char* name;
+    double render_ns = 0.0;
+    double playback_ns = 0.0;
+    size_t table_bytes = 0;
+    bool identical = true;
+};
+
+static bool same_color(const color16& a, const color16& b)
+{
+    return a.r == b.r && a.g == b.g && a.b == b.b;
+}
+
+/**
+ * `render(frame, zones, out)` produces a frame the way the animation used to, once per frame.
+ */
+template <typename Render>
+static cost_report measure(const char* name, size_t frames, size_t zones, int cycles, double gamma, bool dither, Render render)
+{
+    cost_report report{ name };
+    frame_table table = render_cycle(frames, zones, render);
+    report.table_bytes = frames * zones * sizeof(color16);
+
+    volatile uint8_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int c = 0; c < cycles; ++c) {
+        for (size_t frame = 0; frame < frames; ++frame) {
+            std::vector<color16> fine(zones);
+            render(frame, zones, fine.data());
+            std::vector<color> colors(zones);
+            for (size_t i = 0; i < zones; ++i)
+                colors[i] = { static_cast<uint8_t>(fine[i].r >> 8), static_cast<uint8_t>(fine[i].g >> 8), static_cast<uint8_t>(fine[i].b >> 8) };
+            sink = sink + colors[frame % zones].r;
+        }
+    }
+    report.render_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (static_cast<double>(cycles) * frames);
+
+    color_encoder encoder(gamma, dither);
+    std::vector<color> colors;
+    start = std::chrono::steady_clock::now();
+    for (int c = 0; c < cycles; ++c) {
+        for (size_t frame = 0; frame < frames; ++frame) {
+            encoder.encode(table.row(frame), colors);
+            sink = sink + colors[frame % zones].r;
+        }
+    }
+    report.playback_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (static_cast<double>(cycles) * frames);
+
+    std::vector<color16> expected(zones);
+    for (size_t frame = 0; frame < frames; ++frame) {
+        render(frame, zones, expected.data());
+        for (size_t i = 0; i < zones; ++i)
+            report.identical = report.identical && same_color(expected[i], table.frame(frame)[i]);
+    }
+    return report;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t zones = 40;
+    int cycles = 200;
+    double gamma = 1.0;
+    bool dither = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--zones") == 0 && i + 1 < argc) {
+            zones = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+            cycles = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--gamma") == 0 && i + 1 < argc) {
+            gamma = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--dither") == 0) {
+            dither = true;
+        } else {
+            std::cerr << "Usage: nlctl_animation_cost [--zones n] [--cycles n] [--gamma g] [--dither]\n";
+            return 1;
+        }
+    }
+
+    color base{ 255, 128, 32 };
+    std::vector<cost_report> reports;
+    reports.push_back(measure("breathing", 500, zones, cycles, gamma, dither, [&](size_t frame, size_t n, color16* out) { breathing_animation::render_frame(base, 500, frame, n, out); }));
+    reports.push_back(measure("wave", 50, zones, cycles, gamma, dither, [&](size_t frame, size_t n, color16* out) { wave_animation::render_frame(base, frame, n, out); }));
+    reports.push_back(measure("rainbow", 100, zones, cycles, gamma, dither, [&](size_t frame, size_t n, color16* out) { rainbow_animation::render_frame(100, frame, n, out); }));
+
+    std::printf("zones=%zu cycles=%d gamma=%.2f dither=%s\n", zones, cycles, gamma, dither ? "on" : "off");
+    std::printf("%-10s %14s %14s %8s %12s %10s\n", "animation", "render_ns", "playback_ns", "speedup", "table_bytes", "identical");
+    for (const auto& r : reports) {
+        std::printf("%-10s %14.1f %14.1f %8.1f %12zu %10s\n", r.name, r.render_ns, r.playback_ns, r.render_ns / r.playback_ns, r.table_bytes, r.identical ? "yes" : "NO");
+    }
+    return 0;
+}
@@ -0,0 +1,154 @@
+/**
+ * Measures how much per-zone color accuracy a ZoneAnalyzer sample stride costs,
+ * and how much analysis time it saves, over a corpus of raw BGRA frames.
+ *
+ * A corpus can be produced from any video with e.g.
+ *   ffmpeg -i input.mkv -vf scale=3840:2160 -f rawvideo -pix_fmt bgra corpus.bgra
+ */
+#include "zone.hpp"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct stride_report
+{
+    int stride;
+    double error_sum = 0.0;
+    double error_max = 0.0;
+    size_t samples = 0;
+    double seconds = 0.0;
+};
+
+static void usage()
+{
+    std::cerr << "Usage: nlctl_sample_error --size WxH [--zones b,l,t,r] [--depth n] [--strides 1,2,4,8] frames.bgra...\n";
+}
+
+/** Parses all of `text` as an integer of at least 1. */
+static bool parse_positive(std::string_view text, int& value)
+{
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc() && end == text.data() + text.size() && value >= 1;
+}
+
+/** ZoneColor channels are 8.8 fixed point */
+static double channel_error(uint16_t a, uint16_t b)
+{
+    return std::abs(static_cast<int>(a) - static_cast<int>(b)) / 256.0;
+}
+
+int main(int argc, char* argv[])
+{
+    int width = 0, height = 0;
+    int bottom_zones = 10, left_zones = 10, top_zones = 10, right_zones = 10;
+    int depth = 10;
+    std::vector<int> strides{ 1, 2, 3, 4, 6, 8 };
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            if (std::sscanf(argv[++i], "%dx%d", &width, &height) != 2) {
+                usage();
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--zones") == 0 && i + 1 < argc) {
+            if (std::sscanf(argv[++i], "%d,%d,%d,%d", &bottom_zones, &left_zones, &top_zones, &right_zones) != 4) {
+                usage();
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+            if (!parse_positive(argv[++i], depth)) {
+                usage();
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--strides") == 0 && i + 1 < argc) {
+            strides.clear();
+            std::stringstream list(argv[++i]);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                int stride = 0;
+                if (!parse_positive(item, stride)) {
+                    usage();
+                    return 1;
+                }
+                strides.push_back(stride);
+            }
+        } else {
+            files.emplace_back(argv[i]);
+        }
+    }
+
+    if (width <= 0 || height <= 0 || files.empty()) {
+        usage();
+        return 1;
+    }
+
+    size_t frame_bytes = static_cast<size_t>(width) * height * 4;
+    std::vector<uint8_t> frame(frame_bytes);
+    std::vector<stride_report> reports;
+    for (int stride : strides)
+        reports.push_back({ stride });
+
+    ZoneAnalyzer reference(depth, 1);
+    std::vector<ZoneAnalyzer> analyzers;
+    for (int stride : strides)
+        analyzers.emplace_back(depth, stride);
+
+    size_t frames = 0;
+    for (const auto& path : files) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            std::cerr << "Cannot open " << path << '\n';
+            return 1;
+        }
+
+        while (in.read(reinterpret_cast<char*>(frame.data()), frame_bytes)) {
+            auto truth = reference.analyze(frame.data(), width, height, 4, bottom_zones, left_zones, top_zones, right_zones);
+
+            for (size_t s = 0; s < strides.size(); ++s) {
+                /** keep the one-off layout build out of the timings */
+                if (frames == 0) analyzers[s].analyze(frame.data(), width, height, 4, bottom_zones, left_zones, top_zones, right_zones);
+
+                auto start = std::chrono::steady_clock::now();
+                auto zones = analyzers[s].analyze(frame.data(), width, height, 4, bottom_zones, left_zones, top_zones, right_zones);
+                reports[s].seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                for (size_t z = 0; z < zones.size(); ++z) {
+                    double err = std::max({ channel_error(zones[z].r, truth[z].r), channel_error(zones[z].g, truth[z].g), channel_error(zones[z].b, truth[z].b) });
+                    reports[s].error_sum += err;
+                    reports[s].error_max = std::max(reports[s].error_max, err);
+                    reports[s].samples++;
+                }
+            }
+            frames++;
+        }
+    }
+
+    if (frames == 0) {
+        std::cerr << "No complete " << width << "x" << height << " BGRA frames found\n";
+        return 1;
+    }
+
+    /** errors are in 8-bit levels, worst channel per zone */
+    double full_cost = 0.0;
+    for (const auto& r : reports)
+        if (r.stride == 1) full_cost = r.seconds;
+
+    std::printf("frames=%zu size=%dx%d zones=%d,%d,%d,%d depth=%d\n", frames, width, height, bottom_zones, left_zones, top_zones, right_zones, depth);
+    std::printf("%6s %12s %12s %14s %8s\n", "stride", "mean_err", "max_err", "us_per_frame", "speedup");
+    for (const auto& r : reports) {
+        double us = r.seconds * 1e6 / frames;
+        double speedup = full_cost > 0.0 && r.seconds > 0.0 ? full_cost / r.seconds : 0.0;
+        std::printf("%6d %12.3f %12.3f %14.2f %8.2f\n", r.stride, r.error_sum / r.samples, r.error_max, us, speedup);
+    }
+    return 0;
+}